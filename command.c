@@ -24,6 +24,7 @@ command()
     register char ch;
     register int ntimes = 1;			/* Number of player moves */
     static char countch, direction, newcount = FALSE;
+    static int rep_hp, rep_hunger, rep_seen;	/* As a repeat started */
 
 
     if (on(player, ISHASTE)) ntimes++;
@@ -40,8 +41,13 @@ command()
 	status();
 	lastscore = purse;
 	wmove(cw, hero.y, hero.x);
-	if (!((running || count) && jump))
-	    draw(cw);			/* Draw screen */
+	/*
+	 * Asleep, frozen or resting till healed, the screen waits for
+	 * the end of it (a message still shows itself straight away)
+	 */
+	if (!((running || count) && (jump || scr_blind())) && !no_command
+	    && !(count && countch == 'Z'))
+		draw(cw);		/* Draw screen */
 	take = 0;
 	after = TRUE;
 	/*
@@ -51,6 +57,22 @@ command()
 	    waswizard = TRUE;
 	if (!no_command)
 	{
+	    /*
+	     * A run or a repeated command stops for anything new: a
+	     * message, a monster, getting hungrier or getting hurt
+	     */
+	    if ((running || count) && (mpos != 0 || pstats.s_hpt < rep_hp
+		|| hungry_state != rep_hunger || nseen() > rep_seen))
+	    {
+		running = FALSE;
+		count = 0;
+		if (jump)
+		{
+		    status();
+		    wmove(cw, hero.y, hero.x);
+		    draw(cw);
+		}
+	    }
 	    if (running) ch = runch;
 	    else if (count) ch = countch;
 	    else
@@ -58,6 +80,9 @@ command()
 		ch = readchar(cw);
 		if (mpos != 0 && !running)	/* Erase message if its there */
 		    msg("");
+		rep_hp = pstats.s_hpt;
+		rep_hunger = hungry_state;
+		rep_seen = nseen();
 	    }
 	}
 	else ch = ' ';
@@ -175,7 +200,7 @@ command()
 			after = FALSE;
 		when 'v' : msg("Rogue version %s. (mctesq was here)", release);
 		when CTRL('L') : after = FALSE; clearok(curscr,TRUE);draw(curscr);
-		when CTRL('R') : after = FALSE; msg(huh);
+		when CTRL('R') : after = FALSE; recall();
 		when 'S' : 
 		    after = FALSE;
 		    if (save_game())
@@ -183,10 +208,24 @@ command()
 			wmove(cw, LINES-1, 0); 
 			wclrtoeol(cw);
 			draw(cw);
-			endwin();
+			scr_close();
 			exit(0);
 		    }
 		when ' ' : ;			/* Rest command */
+		when 'Z' :			/* Rest until healed */
+		    if (pstats.s_hpt >= max_hp || disturbed())
+		    {
+			if (!count)
+			    msg(pstats.s_hpt >= max_hp ?
+				"You are already healed" : "You can't rest now");
+			count = 0;
+			after = FALSE;
+		    }
+		    else if (!count)
+		    {
+			count = REST_MAX;
+			countch = 'Z';
+		    }
 		when CTRL('P') :
 		    after = FALSE;
 		    if (wizard)
@@ -295,6 +334,7 @@ command()
      */
     if (after)
     {
+	turns++;
 	look(FALSE);
 	do_daemons(AFTER);
 	do_fuses(AFTER);
@@ -307,6 +347,10 @@ command()
 	else if (ISRING(RIGHT, R_TELEPORT) && rnd(100) < 2)
 	    teleport();
     }
+    snapshot();
+    checkpoint();
+    rec_frame();
+    ev_flush();
 }
 
 /*
@@ -327,10 +371,13 @@ int signum;
     draw(cw);
     if (readchar(cw) == 'y')
     {
+	event("quit", "\"gold\":%d,\"level\":%d", purse, level);
+	drop_checkpoint();
+	rec_close();
 	clear();
 	move(LINES-1, 0);
 	draw(stdscr);
-	endwin();
+	scr_close();
 	score(purse, 1, 0);
 	exit(0);
     }
@@ -346,6 +393,40 @@ int signum;
     }
 }
 
+/*
+ * nseen:
+ *	How many monsters he can see
+ */
+
+int
+nseen()
+{
+    register struct linked_list *item;
+    register struct thing *tp;
+    register int n = 0;
+
+    for (item = mlist; item != NULL; item = next(item))
+    {
+	tp = (struct thing *) ldata(item);
+	if (cansee(tp->t_pos.y, tp->t_pos.x)
+	    && (off(*tp, ISINVIS) || on(player, CANSEE)))
+		n++;
+    }
+    return n;
+}
+
+/*
+ * disturbed:
+ *	Is there a reason to stop resting: a monster in sight or
+ *	something to read
+ */
+
+bool
+disturbed()
+{
+    return (mpos != 0 || nseen() > 0);
+}
+
 /*
  * search:
  *	Player gropes about him to find hidden things.
@@ -554,12 +635,15 @@ shell()
     wclear(hw);
     wmove(hw, LINES-1, 0);
     draw(hw);
-    endwin();
+    scr_close();
     in_shell = TRUE;
     fflush(stdout);
+    tty_hold(TRUE);
 
     md_shellescape();
 
+    tty_hold(FALSE);
+
     printf("\n[Press return to continue]");
     fflush(stdout);
     noecho();
@@ -637,5 +721,6 @@ call()
 	guess[obj->o_which] = malloc((unsigned int) strlen(prbuf) + 1);
 	if (guess[obj->o_which] != NULL)
 	strcpy(guess[obj->o_which], prbuf);
+	newnames();
     }
 }
@@ -19,6 +19,9 @@
 #define HAVE_NCURSES_H 1
 #define HAVE_NCURSES_TERM_H 1
 #define HAVE_NLIST_H 1
+#ifndef _WIN32
+#define HAVE_POLL_H 1
+#endif
 #define HAVE_PROCESS_H 1
 #ifndef _WIN32
 #define HAVE_PWD_H 1
@@ -97,6 +97,7 @@ attack(mp)
 register struct thing *mp;
 {
     register char *mname;
+    register int hp;
 
     /*
      * Since this is an attack, stop running and any healing that was
@@ -110,8 +111,11 @@ register struct thing *mp;
 	mname = "it";
     else
 	mname = monsters[mp->t_type-'A'].m_name;
+    hp = pstats.s_hpt;
     if (roll_em(&mp->t_stats, &pstats, NULL, FALSE))
     {
+	event("hit", "\"monster\":\"%s\",\"damage\":%d,\"hp\":%d",
+	    monsters[mp->t_type-'A'].m_name, hp - pstats.s_hpt, pstats.s_hpt);
 	if (mp->t_type != 'E')
 	    hit(mname, NULL);
 	if (pstats.s_hpt <= 0)
@@ -256,7 +260,7 @@ register struct thing *mp;
 			else
 			{
 			    msg("She stole %s!", inv_name(obj, TRUE));
-			    detach(pack, steal);
+			    del_pack(steal);
 			    discard(steal);
 			}
 			inpack--;
@@ -683,6 +687,7 @@ bool pr;
     register struct linked_list *pitem, *nexti;
 
     tp = (struct thing *) ldata(item);
+    event("kill", "\"monster\":\"%s\"", monsters[tp->t_type-'A'].m_name);
     if (pr)
     {
 	addmsg(terse ? "Defeated " : "You have defeated ");
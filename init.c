@@ -12,13 +12,19 @@
 bool playing = TRUE, running = FALSE, wizard = FALSE;
 bool notify = TRUE, fight_flush = FALSE, terse = FALSE, door_stop = FALSE;
 bool jump = FALSE, slow_invent = FALSE, firstmove = FALSE, askme = FALSE;
-bool amulet = FALSE, in_shell = FALSE;
+bool amulet = FALSE, in_shell = FALSE, headless = FALSE;
 struct linked_list *lvl_obj = NULL, *mlist = NULL;
 struct object *cur_weapon = NULL;
 int mpos = 0, no_move = 0, no_command = 0, level = 1, purse = 0, inpack = 0;
 int total = 0, no_food = 0, count = 0, fung_hit = 0, quiet = 0;
 int food_left = HUNGERTIME, group = 1, hungry_state = 0;
+int namegen = 1;
 int lastscore = -1;
+int autosave = 0;
+int turns = 0;
+int ttymax = 0;
+int flyrate = 0;
+int framerate = 30;
 
 struct thing player;
 struct room rooms[MAXROOMS];
@@ -41,7 +47,6 @@ char take;					/* Thing the rogue is taking */
 char runch;					/* Direction player is running */
 char whoami[80];				/* Name of player */
 char fruit[80];				/* Favorite fruit */
-char huh[80];					/* The last message printed */
 int dnum;					/* Dungeon number */
 char *s_names[MAXSCROLLS];			/* Names of the scrolls */
 char *p_colors[MAXPOTIONS];			/* Colors of the potions */
@@ -54,6 +59,12 @@ char *r_guess[MAXRINGS];			/* Players guess at what ring is */
 char *ws_guess[MAXSTICKS];			/* Players guess at what wand is */
 char *ws_type[MAXSTICKS];			/* Is it a wand or a staff */
 char file_name[80];				/* Save file name */
+char rec_file[80];				/* Where to record the game */
+char tty_file[80];				/* Where to record the screen */
+char scr_name[80];				/* How to draw the screen */
+char frame_file[80];				/* Where to record frames */
+char ev_file[80];				/* Where to write events */
+char res_file[80];				/* Where to add the result */
 char home[80];					/* User's home directory */
 char prbuf[100];				/* Buffer for sprintfs */
 char outbuf[BUFSIZ];				/* Output buffer for stdout */
@@ -123,6 +134,7 @@ init_player()
     pstats.s_arm = 10;
     max_stats = pstats;
     pack = NULL;
+    pack_index();
 }
 
 /*
@@ -563,7 +575,8 @@ struct h_list helpstr[] = {
     'c',	"	call object",
     'o',	"	examine/set options",
     CTRL('L'),	"	redraw screen",
-    CTRL('R'),	"	repeat last message",
+    CTRL('R'),	"	repeat messages, newest first",
+    'Z',	"	rest until healed",
     ESCAPE,	"	cancel command",
     'v',	"	print program version number",
     '!',	"	shell escape",
@@ -6,7 +6,10 @@
 
 #include "curses.h"
 #include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <stdarg.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include "rogue.h"
@@ -19,6 +22,15 @@
 static char msgbuf[BUFSIZ];
 static int newpos = 0;
 
+/*
+ * The last M_HIST messages, as they were shown, for recall()
+ */
+#define M_HIST	64
+
+static char m_hist[M_HIST][80];
+static int m_next = 0, m_count = 0;
+static int m_back = 0;			/* How far back ^R has gone */
+
 /*VARARGS1*/
 void
 msg(char *fmt, ...)
@@ -63,14 +75,17 @@ addmsg(char *fmt, ...)
 int
 endmsg()
 {
-    strncpy(huh, msgbuf, 80);
-    huh[79] = 0;
+    sprintf(m_hist[m_next], "%.*s", (int) sizeof m_hist[0] - 1, msgbuf);
+    m_next = (m_next + 1) % M_HIST;
+    if (m_count < M_HIST)
+	m_count++;
 
     if (mpos)
     {
 	wmove(cw, 0, mpos);
 	waddstr(cw, "--More--");
 	draw(cw);
+	scr_flush();			/* even if he has typed ahead */
 	wait_for(cw,' ');
     }
     mvwaddstr(cw, 0, 0, msgbuf);
@@ -85,11 +100,35 @@ doadd(fmt, args)
 char *fmt;
 va_list args;
 {
+    register int n;
+
     /*
      * Do the printf into buf
      */
-    vsprintf(&msgbuf[newpos], fmt, args);
-    newpos = (int) strlen(msgbuf);
+    n = vsnprintf(&msgbuf[newpos], sizeof msgbuf - newpos, fmt, args);
+    if (n > 0)
+	newpos += (n < (int) sizeof msgbuf - newpos) ? n : sizeof msgbuf - 1 - newpos;
+}
+
+/*
+ * recall:
+ *	Show the last message again, or an older one if the key before
+ *	was ^R too.  Past the oldest it starts again from the newest.
+ */
+void
+recall()
+{
+    register char *mp;
+
+    if (m_count == 0)
+	return;
+    if (m_back >= m_count)
+	m_back = 0;
+    m_back++;
+    mp = m_hist[(m_next - m_back + M_HIST) % M_HIST];
+    mvwaddstr(cw, 0, 0, mp);
+    wclrtoeol(cw);
+    mpos = (int) strlen(mp);
 }
 
 /*
@@ -113,6 +152,1778 @@ int ch;
     }
 }
 
+/*
+ * Replays.  With the record option a new game is written down as the
+ * dungeon number, screen size, name and options it started with, then
+ * every key readchar() hands back.  rogue --replay plays it again with
+ * no screen, as fast as it will go, and checks it came out the same.
+ *
+ * Every R_EVERY turns the whole game goes in as a keyframe, and an
+ * index of them goes on the end, so a replay can start from the last
+ * keyframe before the turn it wants instead of from the beginning.
+ */
+#define R_MAGIC	"R36 replay %d\n"
+#define R_VERSION 2		/* 1 had no keyframes */
+#define R_ESC	0xff		/* Next two bytes are a key above 0xfe */
+#define R_END	0xffff		/* The game ended, digest follows */
+#define R_FRAME	0xfffe		/* Keyframe: size, turn, then the game */
+#define R_EVERY	500		/* Turns between keyframes */
+#define R_INDEX	"R36i"		/* After where the index starts */
+
+static FILE *rec_fp = NULL;		/* Recording to */
+static FILE *rp_fp = NULL;		/* Replaying from */
+static long rec_keys = 0;		/* Keys recorded */
+static long rp_keys = 0;		/* Keys replayed */
+static int rp_stop = -1;		/* Turn to stop at */
+
+static struct keyframe {
+    long k_turns;			/* Turn it was taken */
+    long k_keys;			/* Keys before it */
+    long k_where;			/* Where it is in the file */
+} *frames = NULL;
+static int nframes = 0, maxframes = 0;
+
+static void rec_key();
+static int replay_key();
+static void replay_done();
+static void replay_at();
+static void put_key();
+static int get_key();
+static int next_key();
+static void put_long();
+static long get_long();
+
+/*
+ * rec_open:
+ *	Start recording a new game, if he asked for it
+ */
+void
+rec_open()
+{
+    register char *opts;
+
+    if (rec_file[0] == '\0' || headless)
+	return;
+    if ((rec_fp = fopen(rec_file, "w")) == NULL)
+	return;
+    if ((opts = getenv("ROGUEOPTS")) == NULL)
+	opts = "";
+    /*
+     * playit() sets these for slow terminals before reading the options
+     */
+    fprintf(rec_fp, R_MAGIC, R_VERSION);
+    fprintf(rec_fp, "%d %d %d\n%s\n%s%s\n", dnum, LINES, COLS,
+	whoami, scr_slow() ? "terse,jump," : "", opts);
+    fflush(rec_fp);
+}
+
+/*
+ * rec_key:
+ *	Write down a key.  Flushed each time, so a crash still leaves
+ *	the keys that led up to it.
+ */
+static void
+rec_key(ch)
+int ch;
+{
+    put_key(ch);
+    fflush(rec_fp);
+    rec_keys++;
+}
+
+/*
+ * rec_frame:
+ *	Called between commands.  Put in a keyframe if it is time.  Not
+ *	in the middle of a count, a run or a sleep, as command() keeps
+ *	what is being repeated to itself, nor while ^R walks back.
+ */
+void
+rec_frame()
+{
+    static int last = 0;
+    register struct keyframe *kp;
+    register char *img;
+    size_t len;
+
+    if (rec_fp == NULL || turns < last + R_EVERY || count || running
+	|| no_command || m_back)
+	return;
+    last = turns;
+    if ((img = rs_frame(&len)) == NULL || len == 0)
+	return;
+    if (nframes == maxframes)
+    {
+	if ((kp = realloc(frames, (maxframes + 64) * sizeof *kp)) == NULL)
+	    return;
+	frames = kp;
+	maxframes += 64;
+    }
+    kp = &frames[nframes++];
+    kp->k_turns = turns;
+    kp->k_keys = rec_keys;
+    kp->k_where = ftell(rec_fp);
+    put_key(R_FRAME);
+    put_long((long) len);
+    put_long((long) turns);
+    fwrite(img, 1, len, rec_fp);
+    fflush(rec_fp);
+}
+
+/*
+ * put_long, get_long:
+ *	Four bytes, low first
+ */
+static void
+put_long(l)
+register long l;
+{
+    register int i;
+
+    for (i = 0; i < 32; i += 8)
+	putc((int) (l >> i) & 0xff, rec_fp);
+}
+
+static long
+get_long()
+{
+    register int i, c;
+    register unsigned long l;
+
+    l = 0;
+    for (i = 0; i < 32; i += 8)
+    {
+	if ((c = getc(rp_fp)) == EOF)
+	    return -1;
+	l |= (unsigned long) c << i;
+    }
+    return (long) l;
+}
+
+static void
+put_key(ch)
+register int ch;
+{
+    if (ch >= 0 && ch < R_ESC)
+	putc(ch, rec_fp);
+    else
+    {
+	putc(R_ESC, rec_fp);
+	putc((ch >> 8) & 0xff, rec_fp);
+	putc(ch & 0xff, rec_fp);
+    }
+}
+
+static int
+get_key()
+{
+    register int ch, lo;
+
+    if ((ch = getc(rp_fp)) != R_ESC)
+	return ch;
+    if ((ch = getc(rp_fp)) == EOF || (lo = getc(rp_fp)) == EOF)
+	return EOF;
+    return (ch << 8) | lo;
+}
+
+/*
+ * next_key:
+ *	The next key to replay, going past any keyframes
+ */
+static int
+next_key()
+{
+    register int ch;
+    long len;
+
+    while ((ch = get_key()) == R_FRAME)
+	if ((len = get_long()) < 0 || get_long() < 0
+	    || fseek(rp_fp, len, SEEK_CUR) != 0)
+	    return EOF;
+    return ch;
+}
+
+/*
+ * rec_close:
+ *	The game is over.  Put the digest of how it ended on the end of
+ *	the recording, or if this is a replay see if it matches.
+ */
+void
+rec_close()
+{
+    register int i;
+    long where;
+
+    if (headless)
+	replay_done(TRUE, next_key());
+    if (rec_fp == NULL)
+	return;
+    put_key(R_END);
+    put_long((long) rs_digest());
+    /*
+     * Then the index of keyframes
+     */
+    where = ftell(rec_fp);
+    put_long((long) nframes);
+    for (i = 0; i < nframes; i++)
+    {
+	put_long(frames[i].k_turns);
+	put_long(frames[i].k_keys);
+	put_long(frames[i].k_where);
+    }
+    put_long(where);
+    fputs(R_INDEX, rec_fp);
+    fclose(rec_fp);
+    rec_fp = NULL;
+}
+
+/*
+ * replay:
+ *	Set up to play back a recorded game, up to turn stop if that
+ *	isn't -1.  The options, name, dungeon and screen size are put
+ *	where main() will find them.
+ */
+void
+replay(file, stop)
+char *file;
+int stop;
+{
+    char buf[BUFSIZ], opts[BUFSIZ], name[80];
+    int dn, lines, cols, vers;
+
+    if ((rp_fp = fopen(file, "rb")) == NULL)
+    {
+	perror(file);
+	exit(1);
+    }
+    if (fgets(buf, sizeof buf, rp_fp) == NULL
+	|| sscanf(buf, R_MAGIC, &vers) != 1 || vers < 1 || vers > R_VERSION
+	|| fgets(buf, sizeof buf, rp_fp) == NULL
+	|| sscanf(buf, "%d %d %d", &dn, &lines, &cols) != 3 || dn <= 0
+	|| fgets(name, sizeof name, rp_fp) == NULL
+	|| fgets(opts, sizeof opts - sizeof name - 8, rp_fp) == NULL)
+    {
+	fprintf(stderr, "%s: not a rogue replay\n", file);
+	exit(1);
+    }
+    name[strcspn(name, "\n")] = '\0';
+    opts[strcspn(opts, "\n")] = '\0';
+    if (opts[0] != '\0')
+	strcat(opts, ",");
+    strcat(opts, "name=");
+    strcat(opts, name);
+    md_setenv("ROGUEOPTS", opts, 1);
+    sprintf(buf, "%d", dn);
+    md_setenv("SEED", buf, 1);
+    sprintf(buf, "%d", lines);
+    md_setenv("LINES", buf, 1);
+    sprintf(buf, "%d", cols);
+    md_setenv("COLUMNS", buf, 1);
+    rp_stop = stop;
+    headless = TRUE;
+}
+
+/*
+ * replay_seek:
+ *	Called just before the first command.  If the replay is to stop
+ *	somewhere, start from the last keyframe before it.  With no index
+ *	(the recording was cut off) it just starts from the beginning.
+ */
+void
+replay_seek()
+{
+    register int i, n;
+    long start, where, len, t, k, w, best, keys;
+    char magic[4], *img;
+
+    if (rp_stop < 0 || (start = ftell(rp_fp)) < 0)
+	return;
+    best = keys = -1;
+    if (fseek(rp_fp, -8L, SEEK_END) == 0 && (where = get_long()) >= start
+	&& fread(magic, 1, 4, rp_fp) == 4 && memcmp(magic, R_INDEX, 4) == 0
+	&& fseek(rp_fp, where, SEEK_SET) == 0)
+    {
+	n = get_long();
+	for (i = 0; i < n; i++)
+	{
+	    t = get_long();
+	    k = get_long();
+	    if ((w = get_long()) < start || t > rp_stop)
+		break;
+	    best = w;
+	    keys = k;
+	}
+    }
+    img = NULL;
+    if (best < 0 || fseek(rp_fp, best, SEEK_SET) != 0
+	|| get_key() != R_FRAME || (len = get_long()) <= 0 || get_long() < 0
+	|| (img = malloc(len)) == NULL || fread(img, 1, len, rp_fp) != len)
+    {
+	free(img);
+	fseek(rp_fp, start, SEEK_SET);
+	return;
+    }
+    if (rs_read_frame(img, (size_t) len) != 0)
+    {
+	scr_close();
+	printf("Bad keyframe in replay\n");
+	exit(1);
+    }
+    free(img);
+    pack_index();
+    newnames();
+    rp_keys = keys;
+}
+
+/*
+ * replay_key:
+ *	The next key of a replay.  At the end of the keys, or the turn
+ *	he wanted to stop at, stop.
+ */
+static int
+replay_key()
+{
+    register int ch;
+
+    if (rp_stop >= 0 && turns >= rp_stop)
+	replay_at();
+    if ((ch = next_key()) == EOF || ch == R_END)
+	replay_done(FALSE, ch);
+    rp_keys++;
+    return ch;
+}
+
+/*
+ * replay_done:
+ *	Say how the replay came out and quit.  ch is what came after the
+ *	last key used.  If the game ended where the recorded one did, the
+ *	digests have to match.
+ */
+static void
+replay_done(ended, ch)
+bool ended;
+int ch;
+{
+    register unsigned long sum, want;
+
+    sum = rs_digest();
+    scr_close();
+    printf("%ld keys, %d turns, level %d, digest %08lx", rp_keys, turns,
+	level, sum);
+    if (ch == EOF)
+    {
+	/*
+	 * The recording was cut off, by a crash or a hangup
+	 */
+	printf(" (no digest recorded)\n");
+	exit(0);
+    }
+    if (ch != R_END || !ended)
+    {
+	printf(": game did not end where it was recorded\n");
+	exit(1);
+    }
+    want = (unsigned long) get_long() & 0xffffffffUL;
+    if (want != sum)
+    {
+	printf(": should be %08lx\n", want);
+	exit(1);
+    }
+    printf(" ok\n");
+    exit(0);
+}
+
+/*
+ * replay_at:
+ *	Stopped at the turn he asked for.  Say where the game is and
+ *	show what the screen looks like.
+ */
+static void
+replay_at()
+{
+    register int y, x, end;
+    char line[BUFSIZ];
+
+    printf("%ld keys, %d turns, level %d, digest %08lx\n", rp_keys, turns,
+	level, rs_digest());
+    for (y = 0; y < LINES; y++)
+    {
+	end = 0;
+	for (x = 0; x < COLS && x < BUFSIZ - 1; x++)
+	    if ((line[x] = mvwinch(cw, y, x) & A_CHARTEXT) != ' ')
+		end = x + 1;
+	line[end] = '\0';
+	printf("%s\n", line);
+    }
+    scr_close();
+    exit(0);
+}
+
+/*
+ * The terminal.  Where it can, the game leaves the terminal to two
+ * children so that it never waits on it.  tty_in reads the keyboard,
+ * works out what keys were meant and passes them down a pipe that is
+ * the game's stdin.  tty_out takes what curses sends from a pipe that
+ * is the game's stdout and passes it on as fast as the terminal will
+ * take it, keeping what it can't take yet.  If that gets past
+ * T_BACKLOG it is thrown away and the game is asked to redraw, so a
+ * slow line costs screens, never turns.
+ *
+ * ttyrec recording.  With the ttyrec option what curses sends to the
+ * terminal is also written, with the time, to a file in ttyrec format.
+ * tty_out puts a copy of everything in a ring in memory shared with a
+ * third child, which does the writing.  So the disk never holds up
+ * the screen: if the writer falls behind, the ring fills, output is
+ * left out of the recording, and the game is asked to redraw so the
+ * recording catches up.  With ttymax (kilobytes) the files are
+ * rotated, keeping T_KEEP old ones as file.1 and so on.
+ */
+#define T_RING	(1L << 20)	/* Size of the ring */
+#define T_HEAD	12		/* ttyrec frame header: sec, usec, len */
+#define T_KEEP	4		/* Old files kept when rotating */
+#define T_BACKLOG (1L << 18)	/* Most output held for the terminal */
+
+static struct tring {
+    volatile unsigned long t_head;	/* Bytes put in, by the tee */
+    volatile unsigned long t_tail;	/* Bytes taken out, by the writer */
+    char t_buf[T_RING];
+} *tring = NULL;
+
+static volatile int *t_redraw = NULL;	/* Game should redraw the screen */
+
+#ifdef HAVE_WORKING_FORK
+static void ring_writer();
+static bool ring_put();
+static void ring_copy();
+static FILE *tty_rotate();
+#endif
+
+#if defined(HAVE_WORKING_FORK) && defined(HAVE_POLL_H)
+#include <poll.h>
+#include <signal.h>
+
+static void tty_out();
+static void tty_close();
+static void tty_sync();
+
+static int t_pid = -1;			/* The game, not a child of it */
+static int t_inpid = -1;		/* tty_in */
+static int t_ctl = -1, t_ack = -1;	/* Asking tty_out to catch up */
+static int t_ttyin = -1, t_ttyout = -1;	/* The terminal itself */
+static int t_savein = -1, t_saveout = -1; /* The pipes, while on hold */
+
+/*
+ * tty_open:
+ *	Have children run the terminal if we can.  The screen is started
+ *	after, on the pipes to them.
+ */
+void
+tty_open()
+{
+    int out[2], keys[2], ctl[2], ack[2], note[2];
+    register int pid;
+
+    if (headless || t_redraw != NULL || !isatty(0) || !isatty(1)
+	|| !isatty(2) || (t_redraw = md_shmalloc(sizeof *t_redraw)) == NULL)
+	return;
+    *t_redraw = FALSE;
+    note[0] = note[1] = -1;
+    fflush(stdout);
+    if (pipe(out) < 0)
+	goto none;
+    if (pipe(keys) < 0)
+	goto no_keys;
+    if (pipe(ctl) < 0)
+	goto no_ctl;
+    if (pipe(ack) < 0)
+	goto no_ack;
+    t_ttyin = dup(0);
+    t_ttyout = dup(1);
+    if (tty_file[0] != '\0' && (tring = md_shmalloc(sizeof *tring)) != NULL
+	&& pipe(note) == 0)
+    {
+	tring->t_head = tring->t_tail = 0;
+	switch (md_fork())
+	{
+	    case 0:
+		close(note[1]);
+		md_ignoreallsignals();
+		ring_writer(tring, note[0], tty_file, TRUE);
+		/* NOTREACHED */
+	    case -1:
+		close(note[1]);
+		note[1] = -1;
+	}
+	close(note[0]);
+    }
+    if (note[1] < 0)
+	tring = NULL;
+    switch (pid = md_fork())
+    {
+	case 0:
+	    close(out[1]);
+	    close(keys[0]);
+	    close(keys[1]);
+	    close(ctl[1]);
+	    close(ack[0]);
+	    close(t_ttyin);
+	    md_ignoreallsignals();
+	    tty_out(out[0], t_ttyout, ctl[0], ack[1], note[1]);
+	    /* NOTREACHED */
+	case -1:
+	    goto no_out;
+    }
+    close(out[0]);
+    close(ctl[0]);
+    close(ack[1]);
+    if (note[1] >= 0)
+	close(note[1]);
+    switch (t_inpid = md_fork())
+    {
+	case 0:
+	    close(out[1]);
+	    close(keys[0]);
+	    close(ctl[1]);
+	    close(ack[0]);
+	    close(t_ttyout);
+	    md_ignoreallsignals();
+	    /*
+	     * Stop with the game, and when it is in the background
+	     */
+	    signal(SIGTSTP, SIG_DFL);
+	    signal(SIGTTIN, SIG_DFL);
+	    md_keyfeed(t_ttyin, keys[1]);
+	    _exit(0);
+	case -1:
+	    /*
+	     * tty_out goes when its end of ctl is closed
+	     */
+	    close(ctl[1]);
+	    close(ack[0]);
+	    close(keys[0]);
+	    close(keys[1]);
+	    close(out[1]);
+	    md_waitpid(pid, 0);
+	    close(t_ttyin);
+	    close(t_ttyout);
+	    tring = NULL;
+	    t_redraw = NULL;
+	    return;
+    }
+    close(keys[1]);
+    t_pid = getpid();
+    t_ctl = ctl[1];
+    t_ack = ack[0];
+    fcntl(t_ctl, F_SETFD, FD_CLOEXEC);
+    fcntl(t_ack, F_SETFD, FD_CLOEXEC);
+    fcntl(t_ttyin, F_SETFD, FD_CLOEXEC);
+    fcntl(t_ttyout, F_SETFD, FD_CLOEXEC);
+    /*
+     * curses uses stderr for the terminal modes when stdout isn't one
+     */
+    dup2(out[1], 1);
+    close(out[1]);
+    dup2(keys[0], 0);
+    close(keys[0]);
+    md_keyfed();
+    atexit(tty_close);
+    return;
+no_out:
+    if (note[1] >= 0)
+	close(note[1]);
+    tring = NULL;
+    close(t_ttyin);
+    close(t_ttyout);
+    close(ack[0]);
+    close(ack[1]);
+no_ack:
+    close(ctl[0]);
+    close(ctl[1]);
+no_ctl:
+    close(keys[0]);
+    close(keys[1]);
+no_keys:
+    close(out[0]);
+    close(out[1]);
+none:
+    t_redraw = NULL;
+}
+
+/*
+ * tty_sync:
+ *	Wait for tty_out to get everything sent so far to the terminal.
+ *	With quit set it goes away after.
+ */
+static void
+tty_sync(quit)
+bool quit;
+{
+    char c;
+
+    if (t_ctl < 0)
+	return;
+    fflush(stdout);
+    c = quit ? 'q' : 's';
+    if (write(t_ctl, &c, 1) == 1)
+	while (read(t_ack, &c, 1) < 0 && errno == EINTR)
+	    continue;
+}
+
+/*
+ * tty_close:
+ *	Let the terminal catch up as the game goes
+ */
+static void
+tty_close()
+{
+    if (getpid() != t_pid)
+	return;
+    if (t_inpid > 0)
+	md_killchild(t_inpid);
+    t_inpid = -1;
+    tty_sync(TRUE);
+    close(t_ctl);
+    t_ctl = -1;
+}
+
+/*
+ * tty_hold:
+ *	Give the terminal back for a shell, or take it again after
+ */
+void
+tty_hold(hold)
+bool hold;
+{
+    if (t_inpid < 0 || hold == (t_savein >= 0))
+	return;
+    if (hold)
+    {
+	tty_sync(FALSE);
+	kill(t_inpid, SIGSTOP);
+	t_savein = dup(0);
+	t_saveout = dup(1);
+	fcntl(t_savein, F_SETFD, FD_CLOEXEC);
+	fcntl(t_saveout, F_SETFD, FD_CLOEXEC);
+	dup2(t_ttyin, 0);
+	dup2(t_ttyout, 1);
+    }
+    else
+    {
+	fflush(stdout);
+	dup2(t_savein, 0);
+	dup2(t_saveout, 1);
+	close(t_savein);
+	close(t_saveout);
+	t_savein = t_saveout = -1;
+	kill(t_inpid, SIGCONT);
+    }
+}
+
+/*
+ * tty_out:
+ *	Pass the game's output on to the terminal as it will take it,
+ *	and put a copy, as a ttyrec frame, in the ring if note is open
+ */
+static void
+tty_out(in, out, ctl, ack, note)
+int in, out, ctl, ack, note;
+{
+    struct pollfd pfd[3];
+    char buf[BUFSIZ], c, *ob, *nb;
+    register long olen, ooff, osize;
+    register int n, w;
+    long size, sec, usec;
+    bool lost, sync, quit;
+
+    ob = NULL;
+    olen = ooff = osize = size = 0;
+    lost = sync = quit = FALSE;
+    for (;;)
+    {
+	pfd[0].fd = in;
+	pfd[0].events = POLLIN;
+	pfd[1].fd = ctl;
+	pfd[1].events = POLLIN;
+	pfd[2].fd = out;
+	pfd[2].events = (ooff < olen) ? POLLOUT : 0;
+	pfd[0].revents = pfd[1].revents = pfd[2].revents = 0;
+	if (sync)
+	{
+	    /*
+	     * Take in whatever is left, then send it all
+	     */
+	    if (poll(pfd, 1, 0) <= 0)
+	    {
+		for (; ooff < olen; ooff += w)
+		    if ((w = write(out, ob + ooff, olen - ooff)) <= 0
+			&& errno != EINTR)
+			    break;
+			else if (w < 0)
+			    w = 0;
+		olen = ooff = 0;
+		if (quit)
+		    break;
+		write(ack, "", 1);
+		sync = FALSE;
+		continue;
+	    }
+	}
+	else if (poll(pfd, 3, -1) < 0)
+	    continue;
+	if (pfd[2].revents & (POLLERR|POLLHUP|POLLNVAL))
+	{
+	    olen = ooff = 0;		/* the terminal is gone */
+	    out = -1;
+	}
+	else if (pfd[2].revents & POLLOUT)
+	{
+	    n = (olen - ooff < 512) ? olen - ooff : 512;
+	    if ((w = write(out, ob + ooff, n)) > 0 && (ooff += w) == olen)
+		olen = ooff = 0;
+	}
+	if (pfd[1].revents)
+	{
+	    if (read(ctl, &c, 1) != 1 || c == 'q')
+		quit = TRUE;
+	    sync = TRUE;
+	}
+	if (!(pfd[0].revents & (POLLIN|POLLHUP|POLLERR)))
+	    continue;
+	if ((n = read(in, buf, sizeof buf)) <= 0)
+	{
+	    if (n < 0 && errno == EINTR)
+		continue;
+	    in = -1;			/* the game is gone */
+	    quit = sync = TRUE;
+	    continue;
+	}
+	if (olen + n > osize)
+	{
+	    if (ooff > 0)
+	    {
+		memmove(ob, ob + ooff, olen - ooff);
+		olen -= ooff;
+		ooff = 0;
+	    }
+	    if (olen + n > osize && osize < T_BACKLOG
+		&& (nb = realloc(ob, osize + BUFSIZ * 4)) != NULL)
+	    {
+		ob = nb;
+		osize += BUFSIZ * 4;
+	    }
+	    if (olen + n > osize)
+	    {
+		/*
+		 * The terminal is too far behind.  Drop what it hasn't
+		 * had and start it over from a whole screen.
+		 */
+		olen = ooff = 0;
+		*t_redraw = TRUE;
+	    }
+	}
+	if (olen + n <= osize)
+	{
+	    memcpy(ob + olen, buf, n);
+	    olen += n;
+	}
+	if (note < 0)
+	    continue;
+	md_gettime(&sec, &usec);
+	if (ttymax > 0 && size + T_HEAD + n > ttymax * 1024L
+	    && ring_put(tring, NULL, 0, 0L, 0L))
+	{
+	    size = 0;
+	    *t_redraw = TRUE;
+	}
+	if (ring_put(tring, buf, n, sec, usec))
+	{
+	    size += T_HEAD + n;
+	    if (lost)
+		*t_redraw = TRUE;
+	    lost = FALSE;
+	}
+	else
+	    lost = TRUE;
+	write(note, "", 1);
+    }
+    write(ack, "", 1);
+    _exit(0);
+}
+#else
+void
+tty_open()
+{
+}
+
+void
+tty_hold(hold)
+bool hold;
+{
+}
+#endif
+
+#ifdef HAVE_WORKING_FORK
+/*
+ * ring_put:
+ *	Put a frame in the ring, if there is room.  A frame with no
+ *	bytes means start a new file.
+ */
+static bool
+ring_put(r, buf, len, sec, usec)
+register struct tring *r;
+char *buf;
+int len;
+long sec, usec;
+{
+    register unsigned long head;
+    char hdr[T_HEAD];
+    register int i;
+
+    head = r->t_head;
+    if (T_RING - (head - r->t_tail) < (unsigned long) (T_HEAD + len))
+	return FALSE;
+    for (i = 0; i < 4; i++)
+    {
+	hdr[i] = (sec >> (i * 8)) & 0xff;
+	hdr[i + 4] = (usec >> (i * 8)) & 0xff;
+	hdr[i + 8] = (len >> (i * 8)) & 0xff;
+    }
+    ring_copy(r, head, hdr, T_HEAD, TRUE);
+    ring_copy(r, head + T_HEAD, buf, len, TRUE);
+    md_membar();
+    r->t_head = head + T_HEAD + len;
+    return TRUE;
+}
+
+/*
+ * ring_copy:
+ *	Copy into or out of the ring at byte pos, going round the end
+ */
+static void
+ring_copy(r, pos, buf, len, in)
+register struct tring *r;
+unsigned long pos;
+char *buf;
+int len;
+bool in;
+{
+    register int off, n;
+
+    off = pos % T_RING;
+    n = (len < T_RING - off) ? len : T_RING - off;
+    if (in)
+    {
+	memcpy(r->t_buf + off, buf, n);
+	memcpy(r->t_buf, buf + n, len - n);
+    }
+    else
+    {
+	memcpy(buf, r->t_buf + off, n);
+	memcpy(buf + n, r->t_buf, len - n);
+    }
+}
+
+/*
+ * ring_writer:
+ *	Write out what is put in a ring each time the other end says
+ *	so, until it is gone.  The frame headers are written too if
+ *	hdrs is set.
+ */
+static void
+ring_writer(r, note, file, hdrs)
+register struct tring *r;
+int note;
+char *file;
+bool hdrs;
+{
+    register FILE *fp;
+    register unsigned long tail, pos;
+    register int len, left, n;
+    char buf[BUFSIZ], hdr[T_HEAD];
+
+    fp = fopen(file, "wb");
+    do
+    {
+	if ((n = read(note, buf, sizeof buf)) < 0 && errno != EINTR)
+	    break;
+	while ((tail = r->t_tail) != r->t_head)
+	{
+	    md_membar();
+	    ring_copy(r, tail, hdr, T_HEAD, FALSE);
+	    len = (hdr[8] & 0xff) | ((hdr[9] & 0xff) << 8)
+		| ((hdr[10] & 0xff) << 16) | ((hdr[11] & 0xff) << 24);
+	    if (len == 0)
+	    {
+		if (fp != NULL)
+		    fclose(fp);
+		fp = tty_rotate();
+	    }
+	    else if (fp != NULL)
+	    {
+		if (hdrs)
+		    fwrite(hdr, 1, T_HEAD, fp);
+		pos = tail + T_HEAD;
+		for (left = len; left > 0; left -= n)
+		{
+		    n = (left < BUFSIZ) ? left : BUFSIZ;
+		    ring_copy(r, pos, buf, n, FALSE);
+		    fwrite(buf, 1, n, fp);
+		    pos += n;
+		}
+	    }
+	    md_membar();
+	    r->t_tail = tail + T_HEAD + len;
+	}
+	if (fp != NULL)
+	    fflush(fp);
+    } while (n != 0);
+    if (fp != NULL)
+	fclose(fp);
+    _exit(0);
+}
+
+/*
+ * tty_rotate:
+ *	Move the old files along and start a new one
+ */
+static FILE *
+tty_rotate()
+{
+    char from[100], to[100];
+    register int i;
+
+    for (i = T_KEEP; i > 1; i--)
+    {
+	sprintf(from, "%s.%d", tty_file, i - 1);
+	sprintf(to, "%s.%d", tty_file, i);
+	md_rename(from, to);
+    }
+    sprintf(to, "%s.1", tty_file);
+    md_rename(tty_file, to);
+    return fopen(tty_file, "wb");
+}
+#endif
+
+/*
+ * The screen.  draw() goes through display, one of the backends below,
+ * picked by the screen option.  curses diffs on its own.  The others
+ * keep a copy of what they have shown in sh_cells and are handed the
+ * runs that changed by sh_show().
+ */
+#define SH_GAP	3			/* Unchanged cells a run takes in */
+
+static chtype *sh_cells = NULL;		/* What is on the screen */
+static chtype *sh_line = NULL;		/* A line of the window */
+static bool sh_good = FALSE;		/* sh_cells can be believed */
+static WINDOW *sh_last = NULL;		/* Window shown last */
+
+/*
+ * sh_alloc:
+ *	Make room for the copy of the screen
+ */
+static bool
+sh_alloc()
+{
+    sh_cells = (chtype *) malloc(LINES * COLS * sizeof *sh_cells);
+    sh_line = (chtype *) malloc((COLS + 1) * sizeof *sh_line);
+    sh_good = FALSE;
+    return (sh_cells != NULL && sh_line != NULL);
+}
+
+/*
+ * sh_show:
+ *	Bring the screen up to a window, passing on what changed a run at
+ *	a time.  A few unchanged cells between changes go in the run, as
+ *	writing them again is no dearer than going around them.  Showing
+ *	curscr starts over from a blank screen with the window shown last.
+ */
+static int
+sh_show(win)
+register WINDOW *win;
+{
+    register chtype *sp, *lp;
+    register int x, start, same;
+    int y, cy, cx;
+
+    if (win == curscr)
+    {
+	sh_good = FALSE;
+	if ((win = sh_last) == NULL)
+	    return OK;
+    }
+    sh_last = win;
+    if (!sh_good)
+    {
+	(*display->b_clear)();
+	for (sp = sh_cells, x = LINES * COLS; x > 0; x--)
+	    *sp++ = ' ';
+	sh_good = TRUE;
+    }
+    getyx(win, cy, cx);
+    lp = sh_line;
+    for (y = 0; y < LINES; y++)
+    {
+	mvwinchnstr(win, y, 0, lp, COLS);
+	sp = &sh_cells[y * COLS];
+	for (x = 0; x < COLS; x++)
+	{
+	    if (lp[x] == sp[x])
+		continue;
+	    for (start = x, same = 0; x < COLS && same <= SH_GAP; x++)
+		if (lp[x] == sp[x])
+		    same++;
+		else
+		{
+		    sp[x] = lp[x];
+		    same = 0;
+		}
+	    x -= same;
+	    (*display->b_put)(y, start, &lp[start], x - start);
+	}
+    }
+    wmove(win, cy, cx);
+    return (*display->b_flush)(cy, cx);
+}
+
+/*
+ * curses: the way it has always been done
+ */
+static bool
+cur_open()
+{
+    initscr();
+    return TRUE;
+}
+
+static int
+cur_show(win)
+WINDOW *win;
+{
+    return wrefresh(win);
+}
+
+static void
+cur_close()
+{
+    endwin();
+}
+
+/*
+ * ansi: curses keeps the windows but writes to nowhere, and the changes
+ * go out as ANSI escapes on stdout in as few bytes as we can manage.
+ * Each change is reached the cheapest way, short gaps are written over
+ * rather than jumped, and runs of one character are repeated or erased
+ * when the terminal can.  The terminal modes and the keys are done by
+ * hand.  What it costs is counted, and goes in the events file when
+ * the screen is given back.
+ */
+#define A_MOVE	40			/* Longest way of moving we try */
+#define A_SO	(A_STANDOUT | A_REVERSE)
+
+static char a_buf[BUFSIZ];
+static int a_len = 0;
+static int a_y = -1, a_x = -1;		/* The terminal's cursor, if known */
+static chtype a_attr = 0;		/* Standout or not */
+static bool a_on = FALSE;		/* Terminal is in our modes */
+static bool a_rep, a_ech, a_el;		/* It can repeat, erase, clear lines */
+static long a_bytes = 0;		/* Sent since it started */
+static long a_now = 0, a_most = 0;	/* Sent this turn, most in one */
+static int a_turn = 0, a_start = 0;	/* Turn being counted, first turn */
+
+static void
+a_send()
+{
+    register int n, done;
+
+    if (turns != a_turn)
+    {
+	if (a_now > a_most)
+	    a_most = a_now;
+	a_now = 0;
+	a_turn = turns;
+    }
+    a_now += a_len;
+    a_bytes += a_len;
+    for (done = 0; done < a_len; done += n)
+	if ((n = write(1, a_buf + done, a_len - done)) <= 0)
+	{
+	    if (n < 0 && errno == EINTR)
+		n = 0;
+	    else
+		break;
+	}
+    a_len = 0;
+}
+
+static void
+a_out(s, n)
+register char *s;
+register int n;
+{
+    while (n-- > 0)
+    {
+	if (a_len == sizeof a_buf)
+	    a_send();
+	a_buf[a_len++] = *s++;
+    }
+}
+
+static void
+a_puts(s)
+char *s;
+{
+    a_out(s, strlen(s));
+}
+
+/*
+ * a_esc:
+ *	An escape with a count, leaving out a count of 1
+ */
+static int
+a_esc(buf, n, c)
+char *buf;
+int n, c;
+{
+    if (n == 1)
+	return sprintf(buf, "\033[%c", c);
+    return sprintf(buf, "\033[%d%c", n, c);
+}
+
+/*
+ * a_text:
+ *	The character to send for a cell
+ */
+static int
+a_text(c)
+chtype c;
+{
+    register int ch;
+
+    if ((ch = c & A_CHARTEXT) < ' ' || ch > '~')
+	ch = ' ';
+    return ch;
+}
+
+/*
+ * a_across:
+ *	Put in buf the cheapest way along line y from column c to x, and
+ *	return how long it is.  Writing over what is already there is a
+ *	way when it is short and in the standout we are in.
+ */
+static int
+a_across(buf, y, c, x)
+char *buf;
+int y, c, x;
+{
+    char alt[A_MOVE];
+    register chtype *sp;
+    register int i, len, n;
+
+    if (c == x)
+	return 0;
+    if (x == 0)
+    {
+	*buf = '\r';
+	return 1;
+    }
+    len = a_esc(buf, x + 1, 'G');
+    if (x > c)
+    {
+	if ((n = a_esc(alt, x - c, 'C')) < len)
+	{
+	    strcpy(buf, alt);
+	    len = n;
+	}
+	if (x - c < len)
+	{
+	    sp = &sh_cells[y * COLS + c];
+	    for (i = 0; i < x - c; i++)
+		if ((sp[i] & A_SO) != a_attr)
+		    break;
+	    if (i == x - c)
+	    {
+		for (i = 0; i < x - c; i++)
+		    buf[i] = a_text(sp[i]);
+		len = x - c;
+	    }
+	}
+    }
+    else
+    {
+	if ((n = a_esc(alt, c - x, 'D')) < len)
+	{
+	    strcpy(buf, alt);
+	    len = n;
+	}
+	if (c - x < len)
+	{
+	    memset(buf, '\b', c - x);
+	    len = c - x;
+	}
+    }
+    return len;
+}
+
+/*
+ * a_move:
+ *	Get the cursor to y, x: straight there, up or down and along, or
+ *	back to the margin, down and along, whichever is shortest.
+ */
+static void
+a_move(y, x)
+int y, x;
+{
+    char best[A_MOVE], try[A_MOVE];
+    register int len, n, dy;
+
+    if (y == a_y && x == a_x)
+	return;
+    if (y == 0 && x == 0)
+	len = sprintf(best, "\033[H");
+    else if (x == 0)
+	len = sprintf(best, "\033[%dH", y + 1);
+    else
+	len = sprintf(best, "\033[%d;%dH", y + 1, x + 1);
+    if (a_y >= 0)
+    {
+	dy = y - a_y;
+	if (dy == 0)
+	    n = 0;
+	else if (dy == -1)
+	    n = sprintf(try, "\033M");
+	else
+	    n = a_esc(try, (dy > 0) ? dy : -dy, (dy > 0) ? 'B' : 'A');
+	if (n < len && (n += a_across(&try[n], y, a_x, x)) < len)
+	{
+	    memcpy(best, try, n);
+	    len = n;
+	}
+	if (dy >= 0 && dy + 1 < len)
+	{
+	    try[0] = '\r';
+	    memset(&try[1], '\n', dy);
+	    if ((n = dy + 1 + a_across(&try[dy + 1], y, 0, x)) < len)
+	    {
+		memcpy(best, try, n);
+		len = n;
+	    }
+	}
+    }
+    a_out(best, len);
+    a_y = y;
+    a_x = x;
+}
+
+/*
+ * a_standout:
+ *	Be in the standout that c is in
+ */
+static void
+a_standout(c)
+chtype c;
+{
+    if ((c & A_SO) == a_attr)
+	return;
+    a_attr = c & A_SO;
+    a_puts(a_attr ? "\033[7m" : "\033[m");
+}
+
+static void
+ansi_put(y, x, s, n)
+int y, x;
+register chtype *s;
+register int n;
+{
+    char buf[20];
+    register chtype *sp, *end;
+    register int k, len;
+    bool clear;
+
+    /*
+     * If the line is blank after the run, blanks that end it are one
+     * clear to end of line
+     */
+    clear = a_el;
+    end = &sh_cells[(y + 1) * COLS];
+    for (sp = &sh_cells[y * COLS + x + n]; clear && sp < end; sp++)
+	if (*sp != ' ')
+	    clear = FALSE;
+    if (y == LINES - 1 && x + n == COLS)	/* the last place may scroll */
+	n--;
+    if (n <= 0)
+	return;
+    a_move(y, x);
+    while (n > 0)
+    {
+	for (k = 1; k < n && s[k] == s[0]; k++)
+	    continue;
+	a_standout(*s);
+	if (k == n && *s == ' ')	/* the cursor stays put for these */
+	{
+	    if (clear)
+	    {
+		a_puts("\033[K");
+		return;
+	    }
+	    if (a_ech && (len = a_esc(buf, k, 'X')) < k)
+	    {
+		a_out(buf, len);
+		return;
+	    }
+	}
+	buf[0] = a_text(*s);
+	if (a_rep && k > 2 && (len = 1 + a_esc(&buf[1], k - 1, 'b')) < k)
+	    a_out(buf, len);
+	else
+	    for (len = 0; len < k; len++)
+		a_out(buf, 1);
+	s += k;
+	n -= k;
+	if ((a_x += k) >= COLS)
+	    a_y = a_x = -1;
+    }
+}
+
+static int
+ansi_flush(y, x)
+int y, x;
+{
+    a_move(y, x);
+    a_send();
+    return OK;
+}
+
+static void
+ansi_clear()
+{
+    if (!a_on)
+    {
+	md_ttymode(TRUE);
+	a_on = TRUE;
+    }
+    a_puts("\033[m\033[H\033[2J");
+    a_attr = 0;
+    a_y = a_x = 0;
+}
+
+static void
+ansi_close()
+{
+    if (a_on)
+    {
+	a_standout((chtype) ' ');
+	a_move(LINES - 1, 0);
+	a_send();
+	md_ttymode(FALSE);
+	a_on = FALSE;
+	if (a_now > a_most)
+	    a_most = a_now;
+	event("screen", "\"bytes\":%ld,\"per_turn\":%ld,\"most\":%ld",
+	    a_bytes, a_bytes / max(turns - a_start, 1), a_most);
+    }
+    endwin();
+}
+
+static bool
+ansi_open()
+{
+    char buf[10];
+    int lines, cols;
+
+    if (md_ttysize(&lines, &cols))
+    {
+	sprintf(buf, "%d", lines);
+	md_setenv("LINES", buf, 1);
+	sprintf(buf, "%d", cols);
+	md_setenv("COLUMNS", buf, 1);
+    }
+    if (!md_nullscr() || !sh_alloc())
+	return FALSE;
+    a_rep = md_hasrep();
+    a_ech = md_hasech();
+    a_el = md_hasclreol();
+    a_turn = a_start = turns;
+    md_keybulk();
+    fflush(stdout);
+    atexit(ansi_close);
+    return TRUE;
+}
+
+/*
+ * record: every change to the screen goes in frame_file as text, for
+ * tests to look at.  There is no terminal.
+ */
+static FILE *fr_fp = NULL;
+static int fr_count = 0;
+static int fr_y = -1, fr_x = -1;	/* Cursor in the last frame */
+static bool fr_changed = FALSE;
+
+static void
+fr_put(y, x, s, n)
+int y, x;
+chtype *s;
+int n;
+{
+    fr_changed = TRUE;
+}
+
+static int
+fr_flush(y, x)
+int y, x;
+{
+    register chtype *sp;
+    register int i, end;
+
+    if (!fr_changed && y == fr_y && x == fr_x)
+	return OK;
+    fr_changed = FALSE;
+    fr_y = y;
+    fr_x = x;
+    fprintf(fr_fp, "frame %d turn %d cursor %d %d\n", ++fr_count, turns, y, x);
+    for (sp = sh_cells; sp < &sh_cells[LINES * COLS]; sp += COLS)
+    {
+	for (end = COLS; end > 0 && (sp[end - 1] & A_CHARTEXT) == ' '; end--)
+	    continue;
+	for (i = 0; i < end; i++)
+	    putc((int) (sp[i] & A_CHARTEXT), fr_fp);
+	putc('\n', fr_fp);
+    }
+    fflush(fr_fp);
+    return OK;
+}
+
+static void
+fr_clear()
+{
+    fr_changed = TRUE;
+}
+
+static void
+fr_close()
+{
+    fflush(fr_fp);
+    endwin();
+}
+
+static bool
+fr_open()
+{
+    if (frame_file[0] == '\0' || (fr_fp = fopen(frame_file, "w")) == NULL)
+	return FALSE;
+    if (!md_nullscr() || !sh_alloc())
+	return FALSE;
+    md_keybulk();
+    return TRUE;
+}
+
+/*
+ * null: nothing is shown, for replays and batch games
+ */
+static int
+null_show(win)
+WINDOW *win;
+{
+    return OK;
+}
+
+static void
+null_close()
+{
+    endwin();
+}
+
+static bool
+null_open()
+{
+    if (!md_nullscr())
+	return FALSE;
+    md_keybulk();
+    return TRUE;
+}
+
+static struct backend backends[] = {
+    { "curses",	TRUE,	cur_open,	cur_show,	NULL,
+		NULL,		NULL,		cur_close	},
+    { "ansi",	TRUE,	ansi_open,	sh_show,	ansi_put,
+		ansi_flush,	ansi_clear,	ansi_close	},
+    { "record",	FALSE,	fr_open,	sh_show,	fr_put,
+		fr_flush,	fr_clear,	fr_close	},
+    { "null",	FALSE,	null_open,	null_show,	NULL,
+		NULL,		NULL,		null_close	},
+    { NULL }
+};
+
+struct backend *display = backends;
+
+/*
+ * scr_open:
+ *	Start up the screen the screen option asks for, curses if it
+ *	doesn't.  A replay has none unless it is recording frames.
+ */
+bool
+scr_open()
+{
+    register struct backend *bp;
+    register char *name;
+
+    name = scr_name;
+    if (headless && strcmp(name, "record") != 0)
+	name = "null";
+    for (bp = backends; bp->b_name != NULL; bp++)
+	if (strcmp(bp->b_name, name) == 0)
+	    break;
+    if (bp->b_name == NULL)
+	bp = backends;
+    display = bp;
+    if (bp->b_tty)
+	tty_open();
+    return (*bp->b_open)();
+}
+
+/*
+ * scr_slow:
+ *	Whether the screen is a terminal too slow for much drawing.  Only
+ *	curses asks it.
+ */
+bool
+scr_slow()
+{
+    return (display == backends && baudrate() < 1200);
+}
+
+/*
+ * scr_blind:
+ *	Whether nothing drawn is shown at all
+ */
+bool
+scr_blind()
+{
+    return (display->b_show == null_show);
+}
+
+/*
+ * The frame.  draw() only notes the window to be shown, and it goes
+ * out when he is about to wait for a key, when another window is
+ * drawn, or when it has waited a frame (1/framerate of a second) while
+ * the game is busy with keys he typed ahead or a run.  So a turn that
+ * draws many times writes to the terminal once.
+ */
+static WINDOW *sc_win = NULL;		/* Window waiting to be shown */
+static long sc_sec, sc_usec;		/* When it started waiting */
+
+/*
+ * scr_mark:
+ *	Note that a window wants showing
+ */
+int
+scr_mark(win)
+WINDOW *win;
+{
+    long sec, usec;
+
+    if (sc_win != NULL && sc_win != win)
+	scr_flush();
+    if (win == curscr || framerate <= 0)
+	return (*display->b_show)(win);
+    if (headless)
+    {
+	sc_win = win;
+	return OK;
+    }
+    md_gettime(&sec, &usec);
+    if (sc_win == NULL)
+    {
+	sc_win = win;
+	sc_sec = sec;
+	sc_usec = usec;
+    }
+    else if ((sec - sc_sec) * 1000 + (usec - sc_usec) / 1000
+	>= 1000 / framerate)
+	return scr_flush();
+    return OK;
+}
+
+/*
+ * scr_flush:
+ *	Show the window that is waiting, now
+ */
+int
+scr_flush()
+{
+    register WINDOW *win;
+
+    if ((win = sc_win) == NULL)
+	return OK;
+    sc_win = NULL;
+    return (*display->b_show)(win);
+}
+
+/*
+ * scr_close:
+ *	Give the screen back, for a shell or for good.  Drawing again
+ *	takes it back.
+ */
+void
+scr_close()
+{
+    scr_flush();
+    sh_good = FALSE;
+    (*display->b_close)();
+}
+
+/*
+ * The events file.  With the events option the game notes what
+ * happens in it, a line of JSON for each thing, in a ring shared with
+ * a child that writes them out, so the game never waits on the disk.
+ * It is told there is something to write once a turn.  If the ring
+ * fills, events are left out and a "lost" event says how many.
+ */
+static struct tring *ering = NULL;
+static FILE *ev_fp = NULL;
+static int ev_note = -1;
+static long ev_lost = 0;
+
+static void ev_put();
+
+/*
+ * ev_open:
+ *	Start writing events, if he asked for that
+ */
+void
+ev_open()
+{
+#ifdef HAVE_WORKING_FORK
+    int note[2];
+#endif
+
+    if (ev_file[0] == '\0' || headless || ering != NULL || ev_fp != NULL)
+	return;
+#ifdef HAVE_WORKING_FORK
+    if ((ering = md_shmalloc(sizeof *ering)) != NULL && pipe(note) == 0)
+    {
+	ering->t_head = ering->t_tail = 0;
+	switch (md_fork())
+	{
+	    case 0:
+		close(note[1]);
+		md_ignoreallsignals();
+		ring_writer(ering, note[0], ev_file, FALSE);
+		/* NOTREACHED */
+	    case -1:
+		close(note[0]);
+		close(note[1]);
+		break;
+	    default:
+		close(note[0]);
+		fcntl(note[1], F_SETFL, O_NONBLOCK);
+		ev_note = note[1];
+		return;
+	}
+    }
+    ering = NULL;
+#endif
+    ev_fp = fopen(ev_file, "w");
+}
+
+/*
+ * event:
+ *	Note something that happened.  fmt and the rest give the fields
+ *	after the turn and the kind of event.
+ */
+/*VARARGS2*/
+void
+event(char *kind, char *fmt, ...)
+{
+    char buf[BUFSIZ];
+    va_list ap;
+    int n;
+
+    if (ering == NULL && ev_fp == NULL)
+	return;
+    n = sprintf(buf, "{\"turn\":%d,\"event\":\"%s\"", turns, kind);
+    if (*fmt != '\0')
+    {
+	buf[n++] = ',';
+	va_start(ap, fmt);
+	n += vsnprintf(&buf[n], sizeof buf - n - 2, fmt, ap);
+	va_end(ap);
+	if (n > (int) sizeof buf - 3)
+	    n = sizeof buf - 3;
+    }
+    strcpy(&buf[n], "}\n");
+    ev_put(buf, n + 2);
+}
+
+static void
+ev_put(buf, len)
+char *buf;
+int len;
+{
+#ifdef HAVE_WORKING_FORK
+    char lost[80];
+    int n;
+
+    if (ering != NULL)
+    {
+	if (ev_lost > 0)
+	{
+	    n = sprintf(lost, "{\"turn\":%d,\"event\":\"lost\",\"count\":%ld}\n",
+		turns, ev_lost);
+	    if (!ring_put(ering, lost, n, 0L, 0L))
+	    {
+		ev_lost++;
+		return;
+	    }
+	    ev_lost = 0;
+	}
+	if (!ring_put(ering, buf, len, 0L, 0L))
+	    ev_lost++;
+	return;
+    }
+#endif
+    fwrite(buf, 1, len, ev_fp);
+}
+
+/*
+ * ev_flush:
+ *	Have the events so far written out
+ */
+void
+ev_flush()
+{
+    if (ev_note >= 0)
+	write(ev_note, "", 1);
+    else if (ev_fp != NULL)
+	fflush(ev_fp);
+}
+
+/*
+ * fly_frame:
+ *	Show one step of a missile or bolt.  With flyrate at 0 nothing
+ *	is drawn until it is done, otherwise no more than flyrate steps
+ *	are shown a second.
+ */
+void
+fly_frame()
+{
+    static long last_sec = 0, last_usec = 0;
+    long sec, usec, wait;
+
+    if (flyrate <= 0 || headless)
+	return;
+    draw(cw);
+    scr_flush();
+    md_gettime(&sec, &usec);
+    wait = 1000 / flyrate
+	- ((sec - last_sec) * 1000 + (usec - last_usec) / 1000);
+    if (wait > 0)
+    {
+	napms((int) wait);
+	md_gettime(&sec, &usec);
+    }
+    last_sec = sec;
+    last_usec = usec;
+}
+
 /*
  * readchar:
  *	flushes stdout so that screen is up to date and then returns
@@ -125,7 +1936,33 @@ WINDOW *win;
 {
     int ch;
 
-    ch = md_readchar(win);
+    if (t_redraw != NULL && *t_redraw)
+    {
+	/*
+	 * Start the terminal (and the recording) over from a whole screen
+	 */
+	*t_redraw = FALSE;
+	clearok(curscr, TRUE);
+	draw(curscr);
+    }
+    if (headless)
+    {
+	scr_flush();
+	ch = replay_key();
+    }
+    else
+    {
+	if (!md_keyready())
+	{
+	    draw(win);			/* he's waiting on what we show him */
+	    scr_flush();
+	}
+	ch = md_readchar(win);
+    }
+    if (rec_fp != NULL)
+	rec_key(ch);
+    if (ch != CTRL('R'))
+	m_back = 0;
 
     if ((ch == 3) || (ch == 0))
     {
@@ -12,6 +12,13 @@
 #define SCOREFILE	"/var/games/rogue_roll"
 #endif
 
+/*
+ * and the statistics for each player
+ */
+#ifndef STATFILE
+#define STATFILE	SCOREFILE ".sta"
+#endif
+
 /*
  * Variables for checking to make sure the system isn't too loaded
  * for people to play
@@ -42,14 +42,62 @@ char **envp;
     md_init(MD_STRIP_CTRL_KEYPAD);
 
     /*
-     * check for print-score option
+     * check for print-score option, maybe for one player or level
      */
-    if (argc == 2 && strcmp(argv[1], "-s") == 0)
+    if (argc >= 2 && strcmp(argv[1], "-s") == 0)
     {
-	waswizard = TRUE;
-	score(0, -1, 0);
+	int n = 10, lev = 0;
+	char *who = NULL;
+
+	for (argv += 2; *argv != NULL && argv[1] != NULL; argv += 2)
+	    if (strcmp(*argv, "-n") == 0)
+		n = atoi(argv[1]);
+	    else if (strcmp(*argv, "-u") == 0)
+		who = argv[1];
+	    else if (strcmp(*argv, "-l") == 0)
+		lev = atoi(argv[1]);
+	    else
+		break;
+	if (*argv != NULL || n < 1)
+	{
+	    printf("usage: rogue -s [-n count] [-u login] [-l level]\n");
+	    exit(1);
+	}
+	scores(n, who, lev);
+	exit(0);
+    }
+    /*
+     * statistics for a front end
+     */
+    if ((argc == 2 || argc == 3) && strcmp(argv[1], "--stats") == 0)
+    {
+	show_stats((argc == 3) ? argv[2] : NULL);
+	exit(0);
+    }
+    /*
+     * columns of a batch results file
+     */
+    if (argc >= 3 && strcmp(argv[1], "--results") == 0)
+    {
+	show_results(argv[2], &argv[3]);
 	exit(0);
     }
+    /*
+     * list saved games for a front end
+     */
+    if (argc == 3 && strcmp(argv[1], "--list-saves") == 0)
+    {
+	list_saves(argv[2]);
+	exit(0);
+    }
+    /*
+     * play back a recorded game with no screen, maybe up to some turn
+     */
+    if ((argc == 3 || argc == 4) && strcmp(argv[1], "--replay") == 0)
+    {
+	replay(argv[2], (argc == 4) ? atoi(argv[3]) : -1);
+	argc = 1;
+    }
     /*
      * Check to see if he is a wizard
      */
@@ -105,9 +153,9 @@ char **envp;
     else
         dnum = lowtime + getpid();
 
-    if (wizard || env)
+    if (wizard || (env && !headless))
 	printf("Hello %s, welcome to dungeon #%d", whoami, dnum);
-    else
+    else if (!headless)
 	printf("Hello %s, just a moment while I dig the dungeon...", whoami);
     fflush(stdout);
     seed = dnum;
@@ -118,11 +166,15 @@ char **envp;
     init_colors();			/* Set up colors of potions */
     init_stones();			/* Set up stone settings of rings */
     init_materials();			/* Set up materials of wands */
-    initscr();				/* Start up cursor package */
+    if (!scr_open())			/* Start up cursor package */
+    {
+	printf("Cannot start the %s screen\n", display->b_name);
+	exit(1);
+    }
 
     if (COLS < 70)
     {
-	endwin();
+	scr_close();
 	printf("\n\nSorry, %s, but your terminal window has too few columns.\n", whoami);
 	printf("Your terminal has %d columns, needs 70.\n",COLS);
 	exit(1);
@@ -130,13 +182,15 @@ char **envp;
 
     if (LINES < 22)
     {
-	endwin();
+	scr_close();
 	printf("\n\nSorry, %s, but your terminal window has too few lines.\n", whoami);
 	printf("Your terminal has %d lines, needs 22.\n",LINES);
 	exit(1);
     }
 
     setup();
+    rec_open();
+    ev_open();
     /*
      * Set up windows
      */
@@ -238,7 +292,7 @@ char *s;
     move(LINES-2, 0);
     printw("%s", s);
     draw(stdscr);
-    endwin();
+    scr_close();
     exit(0);
 }
 
@@ -280,7 +334,7 @@ tstp(int signum)
     signal(SIGTSTP, SIG_IGN);
 #endif
     mvcur(0, COLS - 1, LINES - 1, 0);
-    endwin();
+    scr_close();
     fflush(stdout);
 #ifdef SIGTSTP
     signal(SIGTSTP, SIG_DFL);
@@ -292,6 +346,7 @@ tstp(int signum)
     clearok(curscr, TRUE);
     touchwin(cw);
     draw(cw);
+    scr_flush();
     flushinp();	/* flush input */
 }
 # endif
@@ -369,7 +424,7 @@ playit()
      * set up defaults for slow terminals
      */
 
-    if (baudrate() < 1200)
+    if (scr_slow())
     {
 	terse = TRUE;
 	jump = TRUE;
@@ -384,6 +439,9 @@ playit()
 
     oldpos = hero;
     oldrp = roomin(&hero);
+    if (headless)
+	replay_seek();
+    snapshot();
     while (playing)
 	command();			/* Command execution */
     endit(0);
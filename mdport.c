@@ -65,8 +65,30 @@
 
 #include <sys/stat.h>
 #include <ctype.h>
+#include <time.h>
 #include <fcntl.h>
 
+#if !defined(_WIN32)
+#include <dirent.h>
+#include <sys/time.h>
+#include <sys/ioctl.h>
+#endif
+
+#ifdef HAVE_TERMIOS_H
+#include <termios.h>
+#endif
+
+#ifdef HAVE_POLL_H
+#include <poll.h>
+#endif
+
+#if defined(HAVE_WORKING_FORK)
+#include <sys/mman.h>
+#if !defined(MAP_ANON) && defined(MAP_ANONYMOUS)
+#define MAP_ANON MAP_ANONYMOUS
+#endif
+#endif
+
 #ifdef HAVE_UTMPX_H /* DJGPP DOES NOT */
 #include <utmpx.h>
 #elif HAVE_UTMP_H
@@ -81,9 +103,17 @@ int md_setsuspchar(int c);
 int directory_exists(char *dirname);
 char *md_getshell(void);
 void md_putchar(int c);
+static int md_ttyfd(void);
 
 static int pass_ctrl_keypad = 1;
 
+#if defined(HAVE_TERMIOS_H)
+static struct termios tty_start;	/* The terminal as the game started */
+static int have_start = 0;
+#endif
+
+#define ESCDELAY_MS 64			/* How long an ESC waits for the rest */
+
 void
 md_init(int options)
 {
@@ -97,7 +127,7 @@ md_init(int options)
 #endif
 
 #ifdef HAVE_ESCDELAY
-    ESCDELAY=64;
+    ESCDELAY=ESCDELAY_MS;
 #else
     if (getenv("ESCDELAY") == NULL)
         md_setenv("ESCDELAY","64",0);
@@ -114,6 +144,11 @@ md_init(int options)
         pass_ctrl_keypad = 0;
     else
         pass_ctrl_keypad = 1;
+
+#if defined(HAVE_TERMIOS_H)
+    if (md_ttyfd() >= 0 && tcgetattr(md_ttyfd(), &tty_start) == 0)
+	have_start = 1;
+#endif
 }
 
 int
@@ -292,6 +327,31 @@ md_hasclreol(void)
 #endif
 }
 
+/*
+ * md_hasrep, md_hasech:
+ *	Whether the terminal can repeat a character, and erase characters
+ *	in place, for drawing the screen without curses
+ */
+int
+md_hasrep(void)
+{
+#if defined(repeat_char) && defined(NCURSES_VERSION)
+    return(cur_term != NULL && repeat_char != NULL && *repeat_char != 0);
+#else
+    return(0);
+#endif
+}
+
+int
+md_hasech(void)
+{
+#if defined(erase_chars) && defined(NCURSES_VERSION)
+    return(cur_term != NULL && erase_chars != NULL && *erase_chars != 0);
+#else
+    return(0);
+#endif
+}
+
 void
 md_putchar(int c)
 {
@@ -373,6 +433,31 @@ md_unlink(char *file)
 #endif
 }
 
+int
+md_rename(const char *from, const char *to)
+{
+#ifdef _WIN32
+    return( MoveFileEx(from, to, MOVEFILE_REPLACE_EXISTING) ? 0 : -1 );
+#else
+    return( rename(from, to) );
+#endif
+}
+
+/*
+ * md_ftruncate:
+ *	Cut an open file down to the given length.
+ */
+int
+md_ftruncate(FILE *fp, long len)
+{
+    fflush(fp);
+#ifdef _WIN32
+    return( _chsize(_fileno(fp), len) );
+#else
+    return( ftruncate(fileno(fp), (off_t) len) );
+#endif
+}
+
 void
 md_normaluser(void)
 {
@@ -596,6 +681,293 @@ md_shellescape(void)
 #endif
 }
 
+/*
+ * md_fork:
+ *	Start a copy of ourselves to do some work in the background.
+ *	Returns -1 where that can't be done, so the caller does the
+ *	work itself.
+ */
+int
+md_fork(void)
+{
+#if defined(HAVE_WORKING_FORK)
+    return( fork() );
+#else
+    return(-1);
+#endif
+}
+
+/*
+ * md_waitpid:
+ *	Collect a child started by md_fork().  Returns the pid once it
+ *	is gone, 0 if nohang is set and it is still running, or -1.
+ */
+int
+md_waitpid(int pid, int nohang)
+{
+#if defined(HAVE_WORKING_FORK)
+    int status, ret;
+
+    while ((ret = waitpid(pid, &status, nohang ? WNOHANG : 0)) < 0)
+	if (errno != EINTR)
+	    break;
+
+    return(ret);
+#else
+    (void) pid;
+    (void) nohang;
+    return(-1);
+#endif
+}
+
+/*
+ * md_killchild:
+ *	Stop a child started by md_fork() and collect it.  Only uses
+ *	calls that are safe from a signal handler.
+ */
+void
+md_killchild(int pid)
+{
+#if defined(HAVE_WORKING_FORK)
+    kill(pid, SIGKILL);
+    md_waitpid(pid, 0);
+#else
+    (void) pid;
+#endif
+}
+
+static int
+md_addname(char ***names, int *n, int *max, const char *name)
+{
+    char **nn;
+
+    if (*n + 1 >= *max)
+    {
+	if ((nn = realloc(*names, (*max + 64) * sizeof(char *))) == NULL)
+	    return(-1);
+	*names = nn;
+	*max += 64;
+    }
+    if (((*names)[*n] = strdup(name)) == NULL)
+	return(-1);
+    (*names)[++*n] = NULL;
+    return(0);
+}
+
+/*
+ * md_listdir:
+ *	The names of the files in a directory, in a malloc()ed array
+ *	ending with NULL.  Returns NULL if the directory can't be read.
+ */
+char **
+md_listdir(const char *dir)
+{
+    char **names = NULL;
+    int n = 0, max = 0;
+#if defined(_WIN32)
+    WIN32_FIND_DATA fd;
+    HANDLE h;
+    char pat[MAX_PATH];
+
+    _snprintf(pat, MAX_PATH, "%s\\*", dir);
+    pat[MAX_PATH - 1] = '\0';
+    if ((h = FindFirstFile(pat, &fd)) == INVALID_HANDLE_VALUE)
+	return(NULL);
+    if ((names = malloc(sizeof(char *))) == NULL)
+	return(NULL);
+    names[0] = NULL;
+    max = 1;
+    do
+	if (!(fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+	    md_addname(&names, &n, &max, fd.cFileName);
+    while (FindNextFile(h, &fd));
+    FindClose(h);
+#else
+    DIR *d;
+    struct dirent *de;
+
+    if ((d = opendir(dir)) == NULL)
+	return(NULL);
+    if ((names = malloc(sizeof(char *))) == NULL)
+	return(NULL);
+    names[0] = NULL;
+    max = 1;
+    while ((de = readdir(d)) != NULL)
+	if (de->d_name[0] != '.')
+	    md_addname(&names, &n, &max, de->d_name);
+    closedir(d);
+#endif
+    return(names);
+}
+
+/*
+ * md_shmalloc:
+ *	Memory that stays shared with children started by md_fork().
+ *	NULL where there is no such thing.
+ */
+void *
+md_shmalloc(size_t size)
+{
+#if defined(HAVE_WORKING_FORK) && defined(MAP_ANON)
+    void *p;
+
+    p = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANON, -1, 0);
+    return( (p == MAP_FAILED) ? NULL : p );
+#else
+    NOOP(size);
+    return(NULL);
+#endif
+}
+
+/*
+ * md_membar:
+ *	Make everything written so far visible to the other side of
+ *	shared memory before anything written after.
+ */
+void
+md_membar(void)
+{
+#if defined(__GNUC__)
+    __sync_synchronize();
+#elif defined(_WIN32)
+    MemoryBarrier();
+#endif
+}
+
+/*
+ * md_gettime:
+ *	The time of day, to the microsecond where we can
+ */
+void
+md_gettime(long *sec, long *usec)
+{
+#if defined(_WIN32)
+    *sec = (long) time(NULL);
+    *usec = 0;
+#else
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    *sec = (long) tv.tv_sec;
+    *usec = (long) tv.tv_usec;
+#endif
+}
+
+/*
+ * md_nullscr:
+ *	Start curses writing to nowhere, for running with no screen.
+ *	Returns 0 if it can't.
+ */
+int
+md_nullscr(void)
+{
+    FILE *fp;
+    char *term;
+
+#ifdef _WIN32
+    fp = fopen("NUL", "w");
+#else
+    fp = fopen("/dev/null", "w");
+#endif
+    if (fp == NULL)
+	return(0);
+    if ((term = getenv("TERM")) == NULL || *term == '\0')
+	term = "vt100";
+    return(newterm(term, fp, stdin) != NULL);
+}
+
+/*
+ * md_ttyfd:
+ *	The terminal, for a game drawing its own screen.  stdin and stdout
+ *	may be pipes to children that have it.
+ */
+static int
+md_ttyfd(void)
+{
+#if !defined(_WIN32)
+    int fd;
+
+    for (fd = 0; fd <= 2; fd++)
+	if (isatty(fd))
+	    return(fd);
+#endif
+    return(-1);
+}
+
+/*
+ * md_ttysize:
+ *	How big the terminal is.  Returns 0 if it can't tell.
+ */
+int
+md_ttysize(int *nlines, int *ncols)
+{
+#if defined(TIOCGWINSZ)
+    struct winsize ws;
+    int fd;
+
+    if ((fd = md_ttyfd()) >= 0 && ioctl(fd, TIOCGWINSZ, &ws) == 0
+	&& ws.ws_row > 0 && ws.ws_col > 0)
+    {
+	*nlines = ws.ws_row;
+	*ncols = ws.ws_col;
+	return(1);
+    }
+#else
+    NOOP(nlines);
+    NOOP(ncols);
+#endif
+    return(0);
+}
+
+/*
+ * md_ttymode:
+ *	Put the terminal in cbreak with no echo, or back the way it was,
+ *	when curses isn't running it.  Returns 0 if it can't.
+ */
+int
+md_ttymode(int raw)
+{
+#if defined(HAVE_TERMIOS_H)
+    static struct termios saved;
+    static int have_saved = 0;
+    struct termios attr;
+    int fd;
+
+    if ((fd = md_ttyfd()) < 0)
+	return(0);
+    if (!raw)
+	return(!have_saved || tcsetattr(fd, TCSADRAIN, &saved) == 0);
+    if (tcgetattr(fd, &attr) < 0)
+	return(0);
+    if (!have_saved)
+    {
+	saved = attr;
+	have_saved = 1;
+    }
+    attr.c_lflag &= ~(ICANON | ECHO);
+    attr.c_cc[VMIN] = 1;
+    attr.c_cc[VTIME] = 0;
+    return(tcsetattr(fd, TCSADRAIN, &attr) == 0);
+#else
+    NOOP(raw);
+    return(0);
+#endif
+}
+
+/*
+ * md_ttyreset:
+ *	Put the terminal modes back the way they were when the game
+ *	started.  It is only a tcsetattr(), so a signal handler may.
+ */
+void
+md_ttyreset(void)
+{
+#if defined(HAVE_TERMIOS_H)
+    if (have_start)
+	tcsetattr(md_ttyfd(), TCSANOW, &tty_start);
+#endif
+}
+
 int
 directory_exists(char *dirname)
 {
@@ -1112,6 +1484,523 @@ unread(int c)
     undo[++uindex] = c;
 }
 
+/*
+ * md_keymap:
+ *	Turn a curses KEY_ code into the command it stands for.
+ */
+static int
+md_keymap(int ch)
+{
+    switch(ch)
+    {
+        case KEY_LEFT   : ch = 'h'; break;
+        case KEY_DOWN   : ch = 'j'; break;
+        case KEY_UP     : ch = 'k'; break;
+        case KEY_RIGHT  : ch = 'l'; break;
+        case KEY_HOME   : ch = 'y'; break;
+        case KEY_PPAGE  : ch = 'u'; break;
+        case KEY_END    : ch = 'b'; break;
+#ifdef KEY_LL
+        case KEY_LL     : ch = 'b'; break;
+#endif
+        case KEY_NPAGE  : ch = 'n'; break;
+
+#ifdef KEY_B1
+        case KEY_B1     : ch = 'h'; break;
+        case KEY_C2     : ch = 'j'; break;
+        case KEY_A2     : ch = 'k'; break;
+        case KEY_B3     : ch = 'l'; break;
+#endif
+        case KEY_A1     : ch = 'y'; break;
+        case KEY_A3     : ch = 'u'; break;
+        case KEY_C1     : ch = 'b'; break;
+        case KEY_C3     : ch = 'n'; break;
+        /* next should be '.', but for problem with putty/linux */
+        case KEY_B2     : ch = 'u'; break;
+
+#ifdef KEY_SLEFT
+	case KEY_SRIGHT  : ch = CTRL('L'); break;
+	case KEY_SLEFT   : ch = CTRL('H'); break;
+#ifdef KEY_SUP
+	case KEY_SUP     : ch = CTRL('K'); break;
+	case KEY_SDOWN   : ch = CTRL('J'); break;
+#endif
+	case KEY_SHOME   : ch = CTRL('Y'); break;
+	case KEY_SPREVIOUS:ch = CTRL('U'); break;
+	case KEY_SEND    : ch = CTRL('B'); break;
+	case KEY_SNEXT   : ch = CTRL('N'); break;
+#endif
+	case 0x146       : ch = CTRL('K'); break; 	/* Shift-Up	*/
+	case 0x145       : ch = CTRL('J'); break; 	/* Shift-Down	*/
+
+#ifdef CTL_RIGHT
+	case CTL_RIGHT   : ch = CTRL('L'); break;
+	case CTL_LEFT    : ch = CTRL('H'); break;
+	case CTL_UP      : ch = CTRL('K'); break;
+	case CTL_DOWN    : ch = CTRL('J'); break;
+	case CTL_HOME    : ch = CTRL('Y'); break;
+	case CTL_PGUP    : ch = CTRL('U'); break;
+	case CTL_END     : ch = CTRL('B'); break;
+	case CTL_PGDN    : ch = CTRL('N'); break;
+#endif
+#ifdef KEY_EOL
+	case KEY_EOL     : ch = CTRL('B'); break;
+#endif
+
+#ifndef CTL_PAD1
+        /* MSYS rxvt console */
+	case 511	     : ch = CTRL('J'); break; /* Shift Dn */
+	case 512         : ch = CTRL('J'); break; /* Ctl Down */
+	case 514	     : ch = CTRL('H'); break; /* Ctl Left */
+	case 516	     : ch = CTRL('L'); break; /* Ctl Right*/
+	case 518	     : ch = CTRL('K'); break; /* Shift Up */
+	case 519	     : ch = CTRL('K'); break; /* Ctl Up   */
+#endif
+
+#ifdef CTL_PAD1
+	case CTL_PAD1   : ch = CTRL('B'); break;
+	case CTL_PAD2   : ch = CTRL('J'); break;
+	case CTL_PAD3   : ch = CTRL('N'); break;
+	case CTL_PAD4   : ch = CTRL('H'); break;
+        case CTL_PAD5   : ch = '.'; break;
+	case CTL_PAD6   : ch = CTRL('L'); break;
+	case CTL_PAD7   : ch = CTRL('Y'); break;
+	case CTL_PAD8   : ch = CTRL('K'); break;
+	case CTL_PAD9   : ch = CTRL('U'); break;
+#endif
+
+#ifdef ALT_RIGHT
+	case ALT_RIGHT  : ch = CTRL('L'); break;
+	case ALT_LEFT   : ch = CTRL('H'); break;
+	case ALT_DOWN   : ch = CTRL('J'); break;
+	case ALT_HOME   : ch = CTRL('Y'); break;
+	case ALT_PGUP   : ch = CTRL('U'); break;
+	case ALT_END    : ch = CTRL('B'); break;
+	case ALT_PGDN   : ch = CTRL('N'); break;
+#endif
+
+#ifdef ALT_PAD1
+	case ALT_PAD1   : ch = CTRL('B'); break;
+	case ALT_PAD2   : ch = CTRL('J'); break;
+	case ALT_PAD3   : ch = CTRL('N'); break;
+	case ALT_PAD4   : ch = CTRL('H'); break;
+        case ALT_PAD5   : ch = '.'; break;
+	case ALT_PAD6   : ch = CTRL('L'); break;
+	case ALT_PAD7   : ch = CTRL('Y'); break;
+	case ALT_PAD8   : ch = CTRL('K'); break;
+	case ALT_PAD9   : ch = CTRL('U'); break;
+#endif
+#ifdef KEY_BACKSPACE /* NCURSES in Keypad mode sends this for Ctrl-H */
+        case KEY_BACKSPACE: ch = CTRL('H'); break;
+#endif
+    }
+
+    return(ch);
+}
+
+/*
+ * md_keyfix:
+ *	Last touches on a key: unless ctrl keypad keys are passed
+ *	through, a translated ^H etc. becomes the run command H etc.
+ */
+static int
+md_keyfix(int ch, int translated)
+{
+    if (!pass_ctrl_keypad && translated)
+        switch(ch) 
+        {
+	    case CTRL('H'):
+	    case CTRL('L'):
+	    case CTRL('K'):
+	    case CTRL('J'):
+	    case CTRL('Y'):
+	    case CTRL('U'):
+	    case CTRL('N'):
+	    case CTRL('B'):
+                return(ch + 0x40);
+        }
+
+    return(ch & 0x7F);
+}
+
+/*
+    Keys that come down a pipe (a bot, or a file of moves) are read in
+    bulk, as many as are there with one read(), into a queue that grows
+    as needed.  The queue is decoded against ktab, every escape sequence
+    curses or the code above would have turned into a key, kept sorted
+    so a lookup is a binary search.  A tty still goes through wgetch().
+*/
+
+#define KS_LEN	12			/* Longest sequence + 1 */
+#define KQ_MIN	4096			/* Least room to read into */
+
+struct keyseq {
+    char k_seq[KS_LEN];
+    int k_ch;
+};
+
+static struct keyseq *ktab = NULL;
+static int nktab = 0, sktab = 0;
+static unsigned char *kq = NULL;
+static size_t kq_head = 0, kq_tail = 0, kq_size = 0;
+static int kbulk = -1;			/* Input is a pipe; -1 until we look */
+
+#define KB_FED	2			/* kbulk when md_keyfeed() decodes */
+
+static void
+kt_add(const char *seq, int ch)
+{
+    struct keyseq *nk;
+    int i;
+
+    if (seq == NULL || seq == (char *) -1 || *seq == '\0'
+      || strlen(seq) >= KS_LEN)
+	return;
+    for (i = 0; i < nktab; i++)
+	if (strcmp(ktab[i].k_seq, seq) == 0)
+	    return;
+    if (nktab == sktab)
+    {
+	if ((nk = realloc(ktab, (sktab + 32) * sizeof *nk)) == NULL)
+	    return;
+	ktab = nk;
+	sktab += 32;
+    }
+    strcpy(ktab[nktab].k_seq, seq);
+    ktab[nktab++].k_ch = ch;
+}
+
+static int
+kt_cmp(const void *a, const void *b)
+{
+    return strcmp(((const struct keyseq *) a)->k_seq,
+	((const struct keyseq *) b)->k_seq);
+}
+
+/*
+ * kt_build:
+ *	What the terminal says its keys send come first, so they win
+ *	over the fixed console sequences when both claim the same bytes.
+ */
+static void
+kt_build(void)
+{
+    static const struct { const char *cap; int key; } caps[] = {
+	{ "kcub1", KEY_LEFT },	{ "kcud1", KEY_DOWN },
+	{ "kcuu1", KEY_UP },	{ "kcuf1", KEY_RIGHT },
+	{ "khome", KEY_HOME },	{ "kpp", KEY_PPAGE },
+	{ "kend", KEY_END },	{ "knp", KEY_NPAGE },
+	{ "ka1", KEY_A1 },	{ "ka3", KEY_A3 },
+	{ "kb2", KEY_B2 },	{ "kc1", KEY_C1 },
+	{ "kc3", KEY_C3 },
+#ifdef KEY_LL
+	{ "kll", KEY_LL },
+#endif
+#ifdef KEY_SLEFT
+	{ "kLFT", KEY_SLEFT },	{ "kRIT", KEY_SRIGHT },
+	{ "kHOM", KEY_SHOME },	{ "kPRV", KEY_SPREVIOUS },
+	{ "kEND", KEY_SEND },	{ "kNXT", KEY_SNEXT },
+#endif
+#ifdef KEY_BACKSPACE
+	{ "kbs", KEY_BACKSPACE },
+#endif
+	{ NULL, 0 }
+    };
+    static const char pad[] = "^$H\1\2\3\4\23\24\25GDCABtvxrwysqu";
+    static const char trail[] = "7Y5U6N1y4b";
+    char buf[KS_LEN + 1], *seq;
+    const char *pp, *pfx;
+    int i, ch;
+
+    for (i = 0; caps[i].cap != NULL; i++)
+    {
+	seq = NULL;
+#if defined(HAVE_TERM_H) || defined(HAVE_NCURSES_TERM_H)
+	seq = tigetstr((char *) caps[i].cap);
+#endif
+	kt_add(seq, md_keymap(caps[i].key));
+	/*
+	 * ESC and an arrow or page key is the ctrl version
+	 */
+	if (seq == NULL || seq == (char *) -1 || strlen(seq) + 1 >= KS_LEN)
+	    continue;
+	switch (caps[i].key)
+	{
+	    case KEY_LEFT : ch = CTRL('H'); break;
+	    case KEY_RIGHT: ch = CTRL('L'); break;
+	    case KEY_UP   : ch = CTRL('K'); break;
+	    case KEY_DOWN : ch = CTRL('J'); break;
+	    case KEY_HOME : ch = CTRL('Y'); break;
+	    case KEY_PPAGE: ch = CTRL('U'); break;
+	    case KEY_NPAGE: ch = CTRL('N'); break;
+	    case KEY_END  : ch = CTRL('B'); break;
+	    default: continue;
+	}
+	sprintf(buf, "\033%s", seq);
+	kt_add(buf, ch);
+    }
+    /*
+     * ESC F, ESC O and ESC [ followed by a keypad code, then the
+     * ones that end in ~ or ^
+     */
+    for (pfx = "FO["; *pfx != '\0'; pfx++)
+    {
+	for (pp = pad; *pp != '\0'; pp++)
+	{
+	    sprintf(buf, "\033%c%c", *pfx, *pp);
+	    switch (*pp)
+	    {
+		case '^': case 4: case 'D': ch = CTRL('H'); break;
+		case '$': case 3: case 'C': ch = CTRL('L'); break;
+		case 1: case 'A': ch = CTRL('K'); break;
+		case 2: case 'B': ch = CTRL('J'); break;
+		case 19: ch = CTRL('U'); break;
+		case 20: ch = CTRL('N'); break;
+		case 21: ch = CTRL('B'); break;
+		case 'H': case 'w': ch = 'y'; break;
+		case 'G': case 'u': ch = '.'; break;
+		case 't': ch = 'h'; break;
+		case 'v': ch = 'l'; break;
+		case 'x': ch = 'k'; break;
+		case 'r': ch = 'j'; break;
+		case 'y': ch = 'u'; break;
+		case 's': ch = 'n'; break;
+		default : ch = 'b'; break;	/* 'q' */
+	    }
+	    kt_add(buf, ch);
+	}
+	for (pp = trail; *pp != '\0'; pp += 2)
+	{
+	    sprintf(buf, "\033%c%c^", *pfx, pp[0]);
+	    kt_add(buf, CTRL(toupper(pp[1])));
+	    sprintf(buf, "\033%c%c~", *pfx, pp[0]);
+	    kt_add(buf, tolower(pp[1]));
+	}
+    }
+    qsort(ktab, nktab, sizeof *ktab, kt_cmp);
+}
+
+/*
+ * kt_decode:
+ *	Take one key off the front of the queue.  Returns how many bytes
+ *	it used, or 0 if they could be the start of a longer sequence and
+ *	more might still come.
+ */
+static int
+kt_decode(int more, int *chp, int *translated)
+{
+    unsigned char *p = &kq[kq_head];
+    int n = (int) (kq_tail - kq_head);
+    int lo, hi, mid, len, best = 0;
+
+    lo = 0;
+    for (len = 1; len <= n && len < KS_LEN; len++)
+    {
+	/*
+	 * First entry not below the len bytes we have
+	 */
+	hi = nktab;
+	while (lo < hi)
+	{
+	    mid = (lo + hi) / 2;
+	    if (strncmp(ktab[mid].k_seq, (char *) p, len) < 0)
+		lo = mid + 1;
+	    else
+		hi = mid;
+	}
+	if (lo == nktab || strncmp(ktab[lo].k_seq, (char *) p, len) != 0)
+	    break;
+	if (ktab[lo].k_seq[len] == '\0')
+	{
+	    best = len;
+	    *chp = ktab[lo].k_ch;
+	}
+    }
+    if (more && len > n && n < KS_LEN - 1 && lo < nktab
+      && (strlen(ktab[lo].k_seq) > (size_t) n || (lo + 1 < nktab
+      && strncmp(ktab[lo + 1].k_seq, (char *) p, (size_t) n) == 0)))
+	return 0;
+    if (best > 0)
+    {
+	*translated = 1;
+	return best;
+    }
+    *chp = *p;
+    *translated = 0;
+    return 1;
+}
+
+/*
+ * kq_fill:
+ *	Read whatever is waiting on fd, waiting at most wait ms for
+ *	something to come (forever if wait < 0).  Returns how many bytes
+ *	came, 0 at the end of the input and -1 if nothing came in time.
+ */
+static int
+kq_fill(int fd, int wait)
+{
+    unsigned char *nq;
+    ssize_t n;
+
+#ifdef HAVE_POLL_H
+    if (wait >= 0)
+    {
+	struct pollfd pfd;
+	int r;
+
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	if ((r = poll(&pfd, 1, wait)) == 0 || (r < 0 && errno == EINTR))
+	    return -1;
+    }
+#endif
+    if (kq_head > 0)
+    {
+	memmove(kq, &kq[kq_head], kq_tail - kq_head);
+	kq_tail -= kq_head;
+	kq_head = 0;
+    }
+    if (kq_size - kq_tail < KQ_MIN)
+    {
+	if ((nq = realloc(kq, kq_size * 2 + KQ_MIN)) == NULL)
+	    return 0;
+	kq = nq;
+	kq_size = kq_size * 2 + KQ_MIN;
+    }
+    while ((n = read(fd, &kq[kq_tail], kq_size - kq_tail)) < 0 && errno == EINTR)
+	continue;
+    if (n <= 0)
+	return 0;
+    kq_tail += n;
+    return (int) n;
+}
+
+/*
+ * md_bulkchar:
+ *	md_readchar() for input that isn't a terminal, or that curses
+ *	isn't reading.  Keys from md_keyfeed() are already decoded.  The
+ *	caller brings the screen up to date when md_keyready() says it
+ *	will have to wait.
+ */
+static int
+md_bulkchar(WINDOW *win)
+{
+    int ch, used, translated, count = 0;
+
+    NOOP(win);
+
+    for (;;)
+    {
+	if (kq_head == kq_tail)
+	{
+	    if (kq_fill(0, -1) <= 0)
+	    {
+		if (count++ > 10)	/* input is gone, save and exit */
+		    auto_save(0);
+		continue;
+	    }
+	}
+	if (kbulk == KB_FED)
+	    return kq[kq_head++];
+	if ((used = kt_decode(1, &ch, &translated)) == 0)
+	{
+	    if (kq_fill(0, ESCDELAY_MS) <= 0)
+		used = kt_decode(0, &ch, &translated);
+	    else
+		continue;
+	}
+	kq_head += used;
+	return md_keyfix(ch, translated);
+    }
+}
+
+/*
+ * md_keyfeed:
+ *	Read the keyboard on in and write the keys it stands for to out,
+ *	for a game that has called md_keyfed().  Returns when the
+ *	keyboard or the game goes away.
+ */
+void
+md_keyfeed(int in, int out)
+{
+    unsigned char buf[256];
+    int ch, used, translated, n, parent;
+
+    parent = getppid();
+#if defined(HAVE_TERM_H) || defined(HAVE_NCURSES_TERM_H)
+    /*
+     * The game starts curses only after we are forked off, so look up
+     * the terminal here or it has no keys to tell us about
+     */
+    if (cur_term == NULL)
+	setupterm(NULL, in, &n);
+#endif
+    kt_build();
+    for (;;)
+    {
+	if (kq_head == kq_tail)
+	{
+	    if ((n = kq_fill(in, 1000)) == 0)
+		return;
+	    if (n < 0)
+	    {
+		if (getppid() != parent)
+		    return;
+		continue;
+	    }
+	}
+	n = 0;
+	while (kq_head < kq_tail && n < (int) sizeof buf)
+	{
+	    if ((used = kt_decode(1, &ch, &translated)) == 0)
+	    {
+		if (n > 0)
+		    break;		/* send what we have before waiting */
+		if (kq_fill(in, ESCDELAY_MS) > 0)
+		    continue;
+		used = kt_decode(0, &ch, &translated);
+	    }
+	    kq_head += used;
+	    buf[n++] = md_keyfix(ch, translated);
+	}
+	if (n > 0 && write(out, buf, n) != n)
+	    return;
+    }
+}
+
+/*
+ * md_keyfed:
+ *	Keys will come from md_keyfeed() on stdin
+ */
+void
+md_keyfed(void)
+{
+    kbulk = KB_FED;
+}
+
+/*
+ * md_keybulk:
+ *	Decode keys ourselves, for when curses isn't running the terminal
+ */
+void
+md_keybulk(void)
+{
+    if (kbulk == KB_FED || kbulk == 1)
+	return;
+    kbulk = 1;
+    kt_build();
+}
+
+/*
+ * md_keyready:
+ *	Whether a key is already waiting, so the screen can wait too
+ */
+int
+md_keyready(void)
+{
+    return(kbulk > 0 && kq_head != kq_tail);
+}
+
 int
 md_readchar(WINDOW *win)
 {
@@ -1123,6 +2012,14 @@ md_readchar(WINDOW *win)
     int nodelayf = 0;
     int count = 0;
 
+    if (kbulk < 0)
+    {
+	if ((kbulk = !isatty(0)) != 0)
+	    kt_build();
+    }
+    if (kbulk)
+	return md_bulkchar(win);
+
     for(;;)
     {
         if (mode == M_NORMAL && uindex >= 0)
@@ -1269,109 +2166,7 @@ md_readchar(WINDOW *win)
             continue;
         }
 
-        switch(ch)
-        {
-            case KEY_LEFT   : ch = 'h'; break;
-            case KEY_DOWN   : ch = 'j'; break;
-            case KEY_UP     : ch = 'k'; break;
-            case KEY_RIGHT  : ch = 'l'; break;
-            case KEY_HOME   : ch = 'y'; break;
-            case KEY_PPAGE  : ch = 'u'; break;
-            case KEY_END    : ch = 'b'; break;
-#ifdef KEY_LL
-            case KEY_LL     : ch = 'b'; break;
-#endif
-            case KEY_NPAGE  : ch = 'n'; break;
-
-#ifdef KEY_B1
-            case KEY_B1     : ch = 'h'; break;
-            case KEY_C2     : ch = 'j'; break;
-            case KEY_A2     : ch = 'k'; break;
-            case KEY_B3     : ch = 'l'; break;
-#endif
-            case KEY_A1     : ch = 'y'; break;
-            case KEY_A3     : ch = 'u'; break;
-            case KEY_C1     : ch = 'b'; break;
-            case KEY_C3     : ch = 'n'; break;
-            /* next should be '.', but for problem with putty/linux */
-            case KEY_B2     : ch = 'u'; break;
-
-#ifdef KEY_SLEFT
-	    case KEY_SRIGHT  : ch = CTRL('L'); break;
-	    case KEY_SLEFT   : ch = CTRL('H'); break;
-#ifdef KEY_SUP
-	    case KEY_SUP     : ch = CTRL('K'); break;
-	    case KEY_SDOWN   : ch = CTRL('J'); break;
-#endif
-	    case KEY_SHOME   : ch = CTRL('Y'); break;
-	    case KEY_SPREVIOUS:ch = CTRL('U'); break;
-	    case KEY_SEND    : ch = CTRL('B'); break;
-	    case KEY_SNEXT   : ch = CTRL('N'); break;
-#endif
-	    case 0x146       : ch = CTRL('K'); break; 	/* Shift-Up	*/
-	    case 0x145       : ch = CTRL('J'); break; 	/* Shift-Down	*/
-
-#ifdef CTL_RIGHT
-	    case CTL_RIGHT   : ch = CTRL('L'); break;
-	    case CTL_LEFT    : ch = CTRL('H'); break;
-	    case CTL_UP      : ch = CTRL('K'); break;
-	    case CTL_DOWN    : ch = CTRL('J'); break;
-	    case CTL_HOME    : ch = CTRL('Y'); break;
-	    case CTL_PGUP    : ch = CTRL('U'); break;
-	    case CTL_END     : ch = CTRL('B'); break;
-	    case CTL_PGDN    : ch = CTRL('N'); break;
-#endif
-#ifdef KEY_EOL
-	    case KEY_EOL     : ch = CTRL('B'); break;
-#endif
-
-#ifndef CTL_PAD1
-            /* MSYS rxvt console */
-	    case 511	     : ch = CTRL('J'); break; /* Shift Dn */
-	    case 512         : ch = CTRL('J'); break; /* Ctl Down */
-	    case 514	     : ch = CTRL('H'); break; /* Ctl Left */
-	    case 516	     : ch = CTRL('L'); break; /* Ctl Right*/
-	    case 518	     : ch = CTRL('K'); break; /* Shift Up */
-	    case 519	     : ch = CTRL('K'); break; /* Ctl Up   */
-#endif
-
-#ifdef CTL_PAD1
-	    case CTL_PAD1   : ch = CTRL('B'); break;
-	    case CTL_PAD2   : ch = CTRL('J'); break;
-	    case CTL_PAD3   : ch = CTRL('N'); break;
-	    case CTL_PAD4   : ch = CTRL('H'); break;
-            case CTL_PAD5   : ch = '.'; break;
-	    case CTL_PAD6   : ch = CTRL('L'); break;
-	    case CTL_PAD7   : ch = CTRL('Y'); break;
-	    case CTL_PAD8   : ch = CTRL('K'); break;
-	    case CTL_PAD9   : ch = CTRL('U'); break;
-#endif
-
-#ifdef ALT_RIGHT
-	    case ALT_RIGHT  : ch = CTRL('L'); break;
-	    case ALT_LEFT   : ch = CTRL('H'); break;
-	    case ALT_DOWN   : ch = CTRL('J'); break;
-	    case ALT_HOME   : ch = CTRL('Y'); break;
-	    case ALT_PGUP   : ch = CTRL('U'); break;
-	    case ALT_END    : ch = CTRL('B'); break;
-	    case ALT_PGDN   : ch = CTRL('N'); break;
-#endif
-
-#ifdef ALT_PAD1
-	    case ALT_PAD1   : ch = CTRL('B'); break;
-	    case ALT_PAD2   : ch = CTRL('J'); break;
-	    case ALT_PAD3   : ch = CTRL('N'); break;
-	    case ALT_PAD4   : ch = CTRL('H'); break;
-            case ALT_PAD5   : ch = '.'; break;
-	    case ALT_PAD6   : ch = CTRL('L'); break;
-	    case ALT_PAD7   : ch = CTRL('Y'); break;
-	    case ALT_PAD8   : ch = CTRL('K'); break;
-	    case ALT_PAD9   : ch = CTRL('U'); break;
-#endif
-#ifdef KEY_BACKSPACE /* NCURSES in Keypad mode sends this for Ctrl-H */
-            case KEY_BACKSPACE: ch = CTRL('H'); break;
-#endif
-        }
+        ch = md_keymap(ch);
 
         break;
     }
@@ -1382,21 +2177,7 @@ md_readchar(WINDOW *win)
 
     uindex = -1;
 
-    if (!pass_ctrl_keypad && (ch != wch))
-        switch(ch) 
-        {
-	    case CTRL('H'):
-	    case CTRL('L'):
-	    case CTRL('K'):
-	    case CTRL('J'):
-	    case CTRL('Y'):
-	    case CTRL('U'):
-	    case CTRL('N'):
-	    case CTRL('B'):
-                return(ch + 0x40);
-        }
-
-    return(ch & 0x7F);
+    return md_keyfix(ch, ch != wch);
 }
 
 #if defined(LOADAV) && defined(HAVE_NLIST_H) && defined(HAVE_NLIST)
@@ -71,13 +71,32 @@ void	md_normaluser(void);
 void	md_raw_standout(void);
 void	md_raw_standend(void);
 int	md_readchar(WINDOW *win);
+void	md_keyfeed(int in, int out);
+void	md_keyfed(void);
+void	md_keybulk(void);
+int	md_keyready(void);
 int	md_setdsuspchar(int c);
 int	md_shellescape(void);
 void	md_sleep(int s);
 int	md_suspchar(void);
 int	md_hasclreol(void);
+int	md_hasrep(void);
+int	md_hasech(void);
 int	md_unlink(char *file);
 int	md_unlink_open_file(const char *file, int inf);
+int	md_rename(const char *from, const char *to);
+int	md_ftruncate(FILE *fp, long len);
+int	md_fork(void);
+int	md_waitpid(int pid, int nohang);
+void	md_killchild(int pid);
+char	**md_listdir(const char *dir);
+int	md_nullscr(void);
+int	md_ttysize(int *nlines, int *ncols);
+int	md_ttymode(int raw);
+void	md_ttyreset(void);
+void	*md_shmalloc(size_t size);
+void	md_membar(void);
+void	md_gettime(long *sec, long *usec);
 void	md_tstpsignal(void);
 void	md_tstphold(void);
 void	md_tstpresume(void (*tstp)(int));
@@ -255,7 +255,7 @@ eat()
 	cur_weapon = NULL;
     if (--obj->o_count < 1)
     {
-	detach(pack, item);
+	del_pack(item);
 	discard(item);
     }
 }
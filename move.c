@@ -6,6 +6,7 @@
 
 #include "curses.h"
 #include <ctype.h>
+#include <stdlib.h>
 #include "rogue.h"
 
 /*
@@ -138,61 +139,92 @@ light(cp)
 coord *cp;
 {
     register struct room *rp;
-    register int j, k;
-    register char ch, rch;
-    register struct linked_list *item;
 
     if ((rp = roomin(cp)) != NULL && !on(player, ISBLIND))
+	show_room(rp);
+}
+
+/*
+ * show_room:
+ *	Put a room on the screen a row at a time, from stdscr if it is
+ *	lit or from what he remembers of it if it is dark, then go back
+ *	for the monsters.  If it is dark, remove anything that might
+ *	move.
+ */
+
+void
+show_room(rp)
+register struct room *rp;
+{
+    static chtype *row = NULL;
+    static int rowlen = 0;
+    register int y, x, n, top, bot;
+    register char ch;
+    register struct linked_list *item;
+    register struct thing *tp;
+    register bool dark;
+    chtype *nrow;
+
+    n = rp->r_max.x;
+    if (n > rowlen)
+    {
+	if ((nrow = realloc(row, (n + 1) * sizeof *row)) == NULL)
+	    return;
+	row = nrow;
+	rowlen = n;
+    }
+    dark = (rp->r_flags & ISDARK) != 0;
+    top = rp->r_pos.y;
+    bot = top + rp->r_max.y - 1;
+    for (y = top; y <= bot; y++)
     {
-	for (j = 0; j < rp->r_max.y; j++)
+	mvwinchnstr(dark ? cw : stdscr, y, rp->r_pos.x, row, n);
+	for (x = 0; x < n; x++)
 	{
-	    for (k = 0; k < rp->r_max.x; k++)
-	    {
-		ch = show(rp->r_pos.y + j, rp->r_pos.x + k);
-		wmove(cw, rp->r_pos.y + j, rp->r_pos.x + k);
-		/*
-		 * Figure out how to display a secret door
-		 */
-		if (ch == SECRETDOOR)
-		{
-		    if (j == 0 || j == rp->r_max.y - 1)
-			ch = '-';
-		    else
-			ch = '|';
-		}
-		/*
-		 * If the room is a dark room, we might want to remove
-		 * monsters and the like from it (since they might
-		 * move)
-		 */
-		if (isupper(ch))
+	    ch = row[x] & A_CHARTEXT;
+	    if (dark)
+		switch (ch)
 		{
-		    item = wake_monster(rp->r_pos.y+j, rp->r_pos.x+k);
-		    if (((struct thing *) ldata(item))->t_oldch == ' ')
-			if (!(rp->r_flags & ISDARK))
-			    ((struct thing *) ldata(item))->t_oldch =
-				mvwinch(stdscr, rp->r_pos.y+j, rp->r_pos.x+k);
-		}
-		if (rp->r_flags & ISDARK)
-		{
-		    rch = mvwinch(cw, rp->r_pos.y+j, rp->r_pos.x+k);
-		    switch (rch)
-		    {
-			case DOOR:
-			case STAIRS:
-			case TRAP:
-			case '|':
-			case '-':
-			case ' ':
-			    ch = rch;
-			when FLOOR:
-			    ch = (on(player, ISBLIND) ? FLOOR : ' ');
-			otherwise:
-			    ch = ' ';
-		    }
+		    case DOOR:
+		    case STAIRS:
+		    case TRAP:
+		    case '|':
+		    case '-':
+		    case ' ':
+			break;
+		    default:
+			row[x] = ' ';
 		}
-		mvwaddch(cw, rp->r_pos.y+j, rp->r_pos.x+k, ch);
+	    /*
+	     * Figure out how to display a secret door or hidden trap
+	     */
+	    else if (ch == SECRETDOOR)
+		row[x] = (y == top || y == bot) ? '-' : '|';
+	    else if (ch == TRAP)
+		row[x] = show(y, rp->r_pos.x + x);
+	}
+	mvwaddchnstr(cw, y, rp->r_pos.x, row, n);
+    }
+    /*
+     * The monsters, taken in the same order as the squares so the
+     * ones that notice him are chosen the same way
+     */
+    for (y = top; y <= bot; y++)
+    {
+	mvwinchnstr(mw, y, rp->r_pos.x, row, n);
+	for (x = 0; x < n; x++)
+	{
+	    if (!isupper(row[x] & A_CHARTEXT))
+		continue;
+	    if (isupper(ch = show(y, rp->r_pos.x + x)))
+	    {
+		item = wake_monster(y, rp->r_pos.x + x);
+		tp = (struct thing *) ldata(item);
+		if (tp->t_oldch == ' ' && !dark)
+		    tp->t_oldch = mvwinch(stdscr, y, rp->r_pos.x + x);
 	    }
+	    if (!dark)
+		mvwaddch(cw, y, rp->r_pos.x + x, ch);
 	}
     }
 }
@@ -18,6 +18,7 @@ new_level()
 
     if (level > max_level)
 	max_level = level;
+    event("level", "\"level\":%d", level);
 
     if (on(player, ISHELD))
     {
@@ -8,6 +8,7 @@
 
 #include "curses.h"
 #include <ctype.h>
+#include <stdlib.h>
 #include <string.h>
 #include "rogue.h"
 
@@ -26,7 +27,7 @@ struct optstruct {
 
 typedef struct optstruct	OPTION;
 
-int	put_bool(), get_bool(), put_str(), get_str();
+int	put_bool(), get_bool(), put_str(), get_str(), put_num(), get_num();
 
 OPTION	optlist[] = {
     {"terse",	 "Terse output: ",
@@ -35,6 +36,10 @@ OPTION	optlist[] = {
 		 (int *) &fight_flush,	put_bool,	get_bool	},
     {"jump",	 "Show position only at end of run: ",
 		 (int *) &jump,		put_bool,	get_bool	},
+    {"flyrate",	 "Missile steps shown a second (0 for none): ",
+		 &flyrate,		put_num,	get_num		},
+    {"framerate", "Screens shown a second when busy (0 for all): ",
+		 &framerate,		put_num,	get_num		},
     {"step",	"Do inventories one line at a time: ",
 		(int *) &slow_invent,	put_bool,	get_bool	},
     {"askme",	"Ask me about unidentified things: ",
@@ -44,7 +49,23 @@ OPTION	optlist[] = {
     {"fruit",	 "Fruit: ",
 		 (int *) fruit,		put_str,	get_str		},
     {"file",	 "Save file: ",
-		 (int *) file_name,	put_str,	get_str		}
+		 (int *) file_name,	put_str,	get_str		},
+    {"autosave", "Autosave every (turns): ",
+		 &autosave,		put_num,	get_num		},
+    {"record",	 "Record game to: ",
+		 (int *) rec_file,	put_str,	get_str		},
+    {"ttyrec",	 "Record screen to: ",
+		 (int *) tty_file,	put_str,	get_str		},
+    {"ttymax",	 "Screen recording size (kilobytes): ",
+		 &ttymax,		put_num,	get_num		},
+    {"screen",	 "Draw the screen with: ",
+		 (int *) scr_name,	put_str,	get_str		},
+    {"frames",	 "Record frames to: ",
+		 (int *) frame_file,	put_str,	get_str		},
+    {"events",	 "Write events to: ",
+		 (int *) ev_file,	put_str,	get_str		},
+    {"results",	 "Add result of game to: ",
+		 (int *) res_file,	put_str,	get_str		}
 };
 
 /*
@@ -96,6 +117,7 @@ option()
     wait_for(hw,' ');
     clearok(cw, TRUE);
     touchwin(cw);
+    newnames();
     after = FALSE;
 }
 
@@ -119,6 +141,16 @@ char *str;
     waddstr(hw, str);
 }
 
+/*
+ * put out a number
+ */
+int
+put_num(ip)
+int *ip;
+{
+    return wprintw(hw, "%d", *ip);
+}
+
 /*
  * allow changing a boolean option and print it out
  */
@@ -240,6 +272,23 @@ WINDOW *win;
 	return NORM;
 }
 
+/*
+ * set a numeric option
+ */
+int
+get_num(ip, win)
+int *ip;
+WINDOW *win;
+{
+    register int retval;
+    char buf[80];
+
+    sprintf(buf, "%d", *ip);
+    retval = get_str(buf, win);
+    *ip = atoi(buf);
+    return retval;
+}
+
 /*
  * parse options from string, usually taken from the environment.
  * the string is a series of comma seperated values, with booleans
@@ -272,6 +321,14 @@ register char *str;
 	    {
 		if (op->o_putfunc == put_bool)	/* if option is a boolean */
 		    *(bool *)op->o_opt = TRUE;
+		else if (op->o_putfunc == put_num)	/* numeric option */
+		{
+		    for (str = sp + 1; *str == '='; str++)
+			continue;
+		    *op->o_opt = atoi(str);
+		    for (sp = str; *sp && *sp != ','; sp++)
+			continue;
+		}
 		else				/* string option */
 		{
 		    register char *start;
@@ -8,6 +8,117 @@
  * @(#)pack.c	3.6 (Berkeley) 6/15/81
  */
 
+/*
+ * The pack is indexed so that letters and merges don't have to walk it.
+ * p_slot[] holds the items in pack order, so the letter of slot i is
+ * 'a' + i, and p_hash maps (type, which, group) to a slot: (type,
+ * which, 0) to the first of that kind, (type, -1, 0) to the last of
+ * that type and (0, 0, group) to the one holding the group.  Anything
+ * that changes the shape of the pack calls pack_index() after.
+ */
+
+#define P_HASH	128			/* Power of two, over 3 * MAXPACK */
+
+static struct linked_list *p_slot[MAXPACK];
+static int p_nslot = 0;
+static struct pkey {
+    int k_type, k_which, k_group;
+    int k_slot;				/* -1 if the entry is free */
+} p_hash[P_HASH];
+
+static struct pkey *
+p_look(type, which, group)
+int type, which, group;
+{
+    register struct pkey *kp;
+    register unsigned int h;
+
+    h = ((unsigned) type * 31 + (unsigned) which * 7 + (unsigned) group) & (P_HASH-1);
+    for (kp = &p_hash[h]; kp->k_slot >= 0; kp = &p_hash[h])
+    {
+	if (kp->k_type == type && kp->k_which == which && kp->k_group == group)
+	    break;
+	h = (h + 1) & (P_HASH-1);
+    }
+    return kp;
+}
+
+static int
+p_find(type, which, group)
+int type, which, group;
+{
+    return p_look(type, which, group)->k_slot;
+}
+
+static void
+p_enter(type, which, group, slot, last)
+int type, which, group, slot;
+bool last;
+{
+    register struct pkey *kp;
+
+    kp = p_look(type, which, group);
+    if (kp->k_slot < 0 || last)
+    {
+	kp->k_type = type;
+	kp->k_which = which;
+	kp->k_group = group;
+	kp->k_slot = slot;
+    }
+}
+
+/*
+ * pack_index:
+ *	Rebuild the letter and merge index after the pack changes shape
+ */
+void
+pack_index()
+{
+    register struct linked_list *ip;
+    register struct object *obj;
+    register int i;
+
+    for (i = 0; i < P_HASH; i++)
+	p_hash[i].k_slot = -1;
+    p_nslot = 0;
+    for (ip = pack; ip != NULL && p_nslot < MAXPACK; ip = next(ip))
+    {
+	obj = (struct object *) ldata(ip);
+	obj->o_slot = p_nslot;
+	p_slot[p_nslot] = ip;
+	p_enter(obj->o_type, obj->o_which, 0, p_nslot, FALSE);
+	p_enter(obj->o_type, -1, 0, p_nslot, TRUE);
+	if (obj->o_group)
+	    p_enter(0, 0, obj->o_group, p_nslot, FALSE);
+	p_nslot++;
+    }
+}
+
+/*
+ * pack_item:
+ *	The pack entry for an inventory letter, or NULL
+ */
+struct linked_list *
+pack_item(ch)
+int ch;
+{
+    if (ch < 'a' || ch >= 'a' + p_nslot)
+	return NULL;
+    return p_slot[ch - 'a'];
+}
+
+/*
+ * del_pack:
+ *	Take an item out of the pack
+ */
+void
+del_pack(item)
+register struct linked_list *item;
+{
+    detach(pack, item);
+    pack_index();
+}
+
 /*
  * add_pack:
  *	Pick up an object and add it to the pack.  If the argument is non-null
@@ -18,10 +129,10 @@ add_pack(item, silent)
 register struct linked_list *item;
 bool silent;
 {
-    register struct linked_list *ip, *lp;
+    register struct linked_list *ip;
     register struct object *obj, *op;
-    register char ch;
-    register bool exact, from_floor;
+    register int slot;
+    register bool from_floor;
 
     if (item == NULL)
     {
@@ -33,36 +144,30 @@ bool silent;
 	from_floor = FALSE;
     obj = (struct object *) ldata(item);
     /*
-     * Link it into the pack.  Search the pack for a object of similar type
-     * if there isn't one, stuff it at the beginning, if there is, look for one
-     * that is exactly the same and just increment the count if there is.
-     * it  that.  Food is always put at the beginning for ease of access, but
-     * is not ordered so that you can't tell good food from bad.  First check
-     * to see if there is something in thr same group and if there is then
-     * increment the count.
+     * Link it into the pack.  If something in the same group is already
+     * there just increment its count.  Otherwise it goes in front of the
+     * first one exactly like it (or is counted in with it if it's a
+     * potion, scroll or food), else after the last of its type, else
+     * after the food, which is always at the beginning for ease of access
+     * but is not ordered so that you can't tell good food from bad.
      */
-    if (obj->o_group)
+    if (obj->o_group && (slot = p_find(0, 0, obj->o_group)) >= 0)
     {
-	for (ip = pack; ip != NULL; ip = next(ip))
+	/*
+	 * Put it in the pack and notify the user
+	 */
+	ip = p_slot[slot];
+	op = (struct object *) ldata(ip);
+	op->o_count++;
+	if (from_floor)
 	{
-	    op = (struct object *) ldata(ip);
-	    if (op->o_group == obj->o_group)
-	    {
-		/*
-		 * Put it in the pack and notify the user
-		 */
-		op->o_count++;
-		if (from_floor)
-		{
-		    detach(lvl_obj, item);
-		    mvaddch(hero.y, hero.x,
-			(roomin(&hero) == NULL ? PASSAGE : FLOOR));
-		}
-		discard(item);
-		item = ip;
-		goto picked_up;
-	    }
+	    detach(lvl_obj, item);
+	    mvaddch(hero.y, hero.x,
+		(roomin(&hero) == NULL ? PASSAGE : FLOOR));
 	}
+	discard(item);
+	item = ip;
+	goto picked_up;
     }
     /*
      * Check if there is room
@@ -92,86 +197,52 @@ bool silent;
 	detach(lvl_obj, item);
 	mvaddch(hero.y, hero.x, (roomin(&hero) == NULL ? PASSAGE : FLOOR));
     }
-    /*
-     * Search for an object of the same type
-     */
-    exact = FALSE;
-    for (ip = pack; ip != NULL; ip = next(ip))
-    {
-	op = (struct object *) ldata(ip);
-	if (obj->o_type == op->o_type)
-	    break;
-    }
-    if (ip == NULL)
+    if ((slot = p_find(obj->o_type, obj->o_which, 0)) >= 0)
     {
 	/*
-	 * Put it at the end of the pack since it is a new type
+	 * If we found an exact match.  If it is a potion, food, or a
+	 * scroll, increase the count, otherwise put it with its clones.
 	 */
-	for (ip = pack; ip != NULL; ip = next(ip))
+	ip = p_slot[slot];
+	if (ISMULT(obj->o_type))
 	{
-	    op = (struct object *) ldata(ip);
-	    if (op->o_type != FOOD)
-		break;
-	    lp = ip;
+	    ((struct object *) ldata(ip))->o_count++;
+	    discard(item);
+	    item = ip;
+	    goto picked_up;
 	}
+	ip = prev(ip);
     }
+    else if ((slot = p_find(obj->o_type, -1, 0)) >= 0
+      || (slot = p_find(FOOD, -1, 0)) >= 0)
+	ip = p_slot[slot];
     else
-    {
-	/*
-	 * Search for an object which is exactly the same
-	 */
-	while (ip != NULL && op->o_type == obj->o_type)
-	{
-	    if (op->o_which == obj->o_which)
-	    {
-		exact = TRUE;
-		break;
-	    }
-	    lp = ip;
-	    if ((ip = next(ip)) == NULL)
-		break;
-	    op = (struct object *) ldata(ip);
-	}
-    }
+	ip = NULL;
+    /*
+     * Link it in after ip, or at the front if there isn't one
+     */
     if (ip == NULL)
     {
-	/*
-	 * Didn't find an exact match, just stick it here
-	 */
-	if (pack == NULL)
-	    pack = item;
-	else
-	{
-	    lp->l_next = item;
-	    item->l_prev = lp;
-	    item->l_next = NULL;
-	}
+	item->l_prev = NULL;
+	if ((item->l_next = pack) != NULL)
+	    pack->l_prev = item;
+	pack = item;
     }
     else
     {
-	/*
-	 * If we found an exact match.  If it is a potion, food, or a 
-	 * scroll, increase the count, otherwise put it with its clones.
-	 */
-	if (exact && ISMULT(obj->o_type))
-	{
-	    op->o_count++;
-	    discard(item);
-	    item = ip;
-	    goto picked_up;
-	}
-	if ((item->l_prev = prev(ip)) != NULL)
-	    item->l_prev->l_next = item;
-	else
-	    pack = item;
-	item->l_next = ip;
-	ip->l_prev = item;
+	item->l_prev = ip;
+	if ((item->l_next = next(ip)) != NULL)
+	    item->l_next->l_prev = item;
+	ip->l_next = item;
     }
+    pack_index();
 picked_up:
     /*
      * Notify the user
      */
     obj = (struct object *) ldata(item);
+    event("pickup", "\"type\":\"%c\",\"which\":%d,\"count\":%d",
+	obj->o_type, obj->o_which, obj->o_count);
     if (notify && !silent)
     {
 	if (!terse)
@@ -298,7 +369,7 @@ void
 picky_inven()
 {
     register struct linked_list *item;
-    register char ch, mch;
+    register char mch;
 
     if (pack == NULL)
 	msg("You aren't carrying anything");
@@ -313,15 +384,14 @@ picky_inven()
 	    msg("");
 	    return;
 	}
-	for (ch = 'a', item = pack; item != NULL; item = next(item), ch++)
-	    if (ch == mch)
-	    {
-		msg("%c) %s",ch,inv_name((struct object *) ldata(item), FALSE));
-		return;
-	    }
+	if ((item = pack_item(mch)) != NULL)
+	{
+	    msg("%c) %s", mch, inv_name((struct object *) ldata(item), FALSE));
+	    return;
+	}
 	if (!terse)
 	    msg("'%s' not in pack", unctrl(mch));
-	msg("Range is 'a' to '%c'", --ch);
+	msg("Range is 'a' to '%c'", 'a' + p_nslot - 1);
     }
 }
 
@@ -335,7 +405,7 @@ char *purpose;
 int type;
 {
     register struct linked_list *obj;
-    register char ch, och;
+    register char ch;
 
     if (pack == NULL)
 	msg("You aren't carrying anything.");
@@ -370,12 +440,10 @@ int type;
 		}
 		continue;
 	    }
-	    for (obj = pack, och = 'a'; obj != NULL; obj = next(obj), och++)
-		if (ch == och)
-		    break;
-	    if (obj == NULL)
+	    if ((obj = pack_item(ch)) == NULL)
 	    {
-		msg("Please specify a letter between 'a' and '%c'", och-1);
+		msg("Please specify a letter between 'a' and '%c'",
+		    'a' + p_nslot - 1);
 		continue;
 	    }
 	    else 
@@ -385,18 +453,18 @@ int type;
     return NULL;
 }
 
+/*
+ * pack_char:
+ *	The inventory letter of something in the pack
+ */
 int
 pack_char(obj)
 register struct object *obj;
 {
-    register struct linked_list *item;
-    register char c;
+    register int s;
 
-    c = 'a';
-    for (item = pack; item != NULL; item = next(item))
-	if ((struct object *) ldata(item) == obj)
-	    return c;
-	else
-	    c++;
+    s = obj->o_slot;
+    if (s >= 0 && s < p_nslot && (struct object *) ldata(p_slot[s]) == obj)
+	return 'a' + s;
     return 'z';
 }
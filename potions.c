@@ -33,6 +33,7 @@ quaff()
     }
     if (obj == cur_weapon)
 	cur_weapon = NULL;
+    event("quaff", "\"potion\":\"%s\"", p_magic[obj->o_which].mi_name);
 
     /*
      * Calculate the effect it has on the poor guy.
@@ -189,6 +190,7 @@ quaff()
 	    strcpy(p_guess[obj->o_which], buf);
 	}
     }
+    newnames();
     /*
      * Throw the item away
      */
@@ -197,7 +199,7 @@ quaff()
 	obj->o_count--;
     else
     {
-	detach(pack, item);
+	del_pack(item);
         discard(item);
     }
 }
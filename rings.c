@@ -95,6 +95,7 @@ ring_on()
 	}
 	msg("");
     }
+    newnames();
 }
 
 void
@@ -52,6 +52,10 @@ register char monst;
     time_t date;
     char buf[80];
 
+    event("death", "\"cause\":\"%s\",\"gold\":%d,\"level\":%d",
+	killname(monst), purse - purse/10, level);
+    drop_checkpoint();
+    rec_close();
     time(&date);
     lt = localtime(&date);
     clear();
@@ -70,64 +74,1203 @@ register char monst;
     move(LINES-1, 0);
     draw(stdscr);
     score(purse, 0, monst);
-    endwin();
+    scr_close();
     exit(0);
 }
 
 /*
- * score -- figure score and post it.
+ * The score file is a log.  After a header come the entries sorted
+ * best first as of the last compaction, then an index of those by
+ * login and one by level, then whatever has been added since, in
+ * the order it came.  Everything is done under the file lock, and
+ * once the unsorted tail gets long a child folds it in.  The header
+ * says where the sorted entries start, as a compaction builds them
+ * past the end of the file and only then switches to them.
  */
 
-/* VARARGS2 */
-void
-score(amount, flags, monst)
+#define SC_HEAD	100		/* length of the header */
+#define SC_SIZE	160		/* length of an entry */
+#define SC_TAIL	256		/* compact after this many additions */
+#define SC_GONE	-2		/* sc_flags of an entry edited out */
+
+#define sc_pos(i)	(sc_base + (long) (i) * SC_SIZE)
+
+struct sc_ent {
+    int sc_score;
+    char sc_name[80];
+    int sc_flags;
+    int sc_level;
+    char sc_login[16];
+    int sc_monster;
+    long sc_time;
+    long sc_where;		/* where it is in the file */
+};
+
+struct sc_key {
+    char k_login[16];
+    int k_level;
+    int k_rec;
+};
+
+static int sc_nsort;		/* number of sorted entries */
+static long sc_base;		/* where they start */
+static long sc_tail;		/* where the unsorted ones start */
+static int sc_ntail;		/* and how many of them there are */
+
+static char *reason[] = {
+    "killed",
+    "quit",
+    "A total winner",
+};
+
+/*
+ * sc_get, sc_put:
+ *	Read or write one entry
+ */
+
+static int
+sc_get(fp, where, scp)
+FILE *fp;
+long where;
+register struct sc_ent *scp;
+{
+    char buf[SC_SIZE];
+
+    if (fseek(fp, where, 0) != 0 || fread(buf, SC_SIZE, 1, fp) != 1)
+	return FALSE;
+    enccrypt(buf, SC_SIZE);
+    memcpy(scp->sc_name, buf, 80);
+    scp->sc_name[79] = '\0';
+    memcpy(scp->sc_login, &buf[80], 16);
+    scp->sc_login[15] = '\0';
+    buf[SC_SIZE-1] = '\0';
+    if (sscanf(&buf[96], " %d %d %d %d %ld", &scp->sc_score,
+	&scp->sc_flags, &scp->sc_level, &scp->sc_monster, &scp->sc_time) != 5)
+	    return FALSE;
+    if (scp->sc_flags != SC_GONE && (scp->sc_flags < 0 || scp->sc_flags > 2))
+	return FALSE;
+    scp->sc_where = where;
+    return TRUE;
+}
+
+static int
+sc_put(fp, where, scp)
+FILE *fp;
+long where;
+register struct sc_ent *scp;
+{
+    char buf[SC_SIZE];
+
+    memset(buf, 0, SC_SIZE);
+    memcpy(buf, scp->sc_name, strlen(scp->sc_name));
+    memcpy(&buf[80], scp->sc_login, strlen(scp->sc_login));
+    snprintf(&buf[96], SC_SIZE - 96, " %d %d %d %d %ld \n", scp->sc_score,
+	scp->sc_flags, scp->sc_level, scp->sc_monster, scp->sc_time);
+    enccrypt(buf, SC_SIZE);
+    return (fseek(fp, where, 0) == 0 && fwrite(buf, SC_SIZE, 1, fp) == 1);
+}
+
+/*
+ * sc_cmp:
+ *	Best score first, and the older of two equal ones
+ */
+
+static int
+sc_cmp(a, b)
+const void *a, *b;
+{
+    register const struct sc_ent *s1 = a, *s2 = b;
+
+    if (s1->sc_score != s2->sc_score)
+	return (s1->sc_score > s2->sc_score) ? -1 : 1;
+    if (s1->sc_time != s2->sc_time)
+	return (s1->sc_time < s2->sc_time) ? -1 : 1;
+    return (s1->sc_where < s2->sc_where) ? -1 : (s1->sc_where > s2->sc_where);
+}
+
+static int
+sc_bylogin(a, b)
+const void *a, *b;
+{
+    register const struct sc_key *k1 = a, *k2 = b;
+    register int c;
+
+    if ((c = strcmp(k1->k_login, k2->k_login)) != 0)
+	return c;
+    return k1->k_rec - k2->k_rec;
+}
+
+static int
+sc_bylevel(a, b)
+const void *a, *b;
+{
+    register const struct sc_key *k1 = a, *k2 = b;
+
+    if (k1->k_level != k2->k_level)
+	return k1->k_level - k2->k_level;
+    return k1->k_rec - k2->k_rec;
+}
+
+/*
+ * sc_idx:
+ *	Entry number at a place in one of the indexes (0 login, 1 level)
+ */
+
+static int
+sc_idx(fp, which, i)
+FILE *fp;
+int which, i;
+{
+    unsigned char b[4];
+
+    if (fseek(fp, sc_pos(sc_nsort) + ((long) which * sc_nsort + i) * 4, 0) != 0
+	|| fread(b, 4, 1, fp) != 1)
+	    return -1;
+    return b[0] | (b[1] << 8) | (b[2] << 16) | ((int) b[3] << 24);
+}
+
+/*
+ * sc_head:
+ *	Write the header: how many are sorted and where they start, and
+ *	if not 0, the length the file is to be cut back to
+ */
+
+static int
+sc_head(fp, n, base, clip)
+FILE *fp;
+int n;
+long base, clip;
+{
+    char buf[SC_HEAD];
+
+    memset(buf, 0, SC_HEAD);
+    sprintf(buf, "R36 %d %d %ld %ld\n", 4, n, base, clip);
+    enccrypt(buf, SC_HEAD);
+    return (fseek(fp, 0L, 0) == 0 && fwrite(buf, SC_HEAD, 1, fp) == 1
+	&& fflush(fp) == 0);
+}
+
+/*
+ * sc_compact:
+ *	Sort the tail into the rest and rebuild the indexes.  The new
+ *	table is written past the end of the file, with the header saying
+ *	to cut it off if we die first, and the header switched to it
+ *	last.  If it fits in front of where the old one started it is
+ *	then copied down there and switched to the same way.  It has to
+ *	be done in the file, as the score file's directory is usually not
+ *	ours to write.
+ */
+
+static void
+sc_compact(fp)
+FILE *fp;
+{
+    register struct sc_ent *tl, *ep;
+    register struct sc_key *keys;
+    register int i, j, k, n, nt;
+    struct sc_ent cur;
+    unsigned char b[4];
+    char buf[BUFSIZ];
+    long end, size, done;
+    bool have;
+
+    tl = malloc((sc_ntail + 1) * sizeof *tl);
+    keys = malloc((sc_nsort + sc_ntail + 1) * sizeof *keys);
+    if (tl == NULL || keys == NULL || fseek(fp, 0L, 2) != 0
+	|| (end = ftell(fp)) < 0 || !sc_head(fp, sc_nsort, sc_base, end))
+	    goto out;
+    for (i = nt = 0; i < sc_ntail; i++)
+	if (sc_get(fp, sc_tail + (long) i * SC_SIZE, &tl[nt])
+	    && tl[nt].sc_flags != SC_GONE)
+		nt++;
+    qsort(tl, nt, sizeof *tl, sc_cmp);
+    /*
+     * Merge the two, leaving out the ones edited away
+     */
+    have = FALSE;
+    for (i = j = n = 0; i < sc_nsort || j < nt; )
+    {
+	if (i < sc_nsort && !have)
+	{
+	    if (!sc_get(fp, sc_pos(i), &cur))
+		cur.sc_flags = SC_GONE;
+	    have = TRUE;
+	}
+	if (have && cur.sc_flags == SC_GONE)
+	{
+	    i++;
+	    have = FALSE;
+	    continue;
+	}
+	if (have && (j >= nt || sc_cmp(&cur, &tl[j]) <= 0))
+	{
+	    ep = &cur;
+	    i++;
+	    have = FALSE;
+	}
+	else
+	    ep = &tl[j++];
+	if (!sc_put(fp, end + (long) n * SC_SIZE, ep))
+	    goto undo;
+	strcpy(keys[n].k_login, ep->sc_login);
+	keys[n].k_level = ep->sc_level;
+	keys[n].k_rec = n;
+	n++;
+    }
+    if (fseek(fp, end + (long) n * SC_SIZE, 0) != 0)
+	goto undo;
+    for (k = 0; k < 2; k++)
+    {
+	qsort(keys, n, sizeof *keys, k == 0 ? sc_bylogin : sc_bylevel);
+	for (i = 0; i < n; i++)
+	{
+	    b[0] = keys[i].k_rec;
+	    b[1] = keys[i].k_rec >> 8;
+	    b[2] = keys[i].k_rec >> 16;
+	    b[3] = keys[i].k_rec >> 24;
+	    if (fwrite(b, 4, 1, fp) != 1)
+		goto undo;
+	}
+    }
+    if (fflush(fp) != 0 || !sc_head(fp, n, end, 0L))
+	goto undo;
+    size = (long) n * (SC_SIZE + 8);
+    sc_nsort = n;
+    sc_base = end;
+    sc_tail = end + size;
+    sc_ntail = 0;
+    /*
+     * Bring it down to the front if there is room, or there will be
+     * next time
+     */
+    if (SC_HEAD + size > end)
+	goto out;
+    for (done = 0; done < size; done += k)
+    {
+	k = (size - done < (long) sizeof buf) ? size - done : sizeof buf;
+	if (fseek(fp, end + done, 0) != 0 || fread(buf, k, 1, fp) != 1
+	    || fseek(fp, SC_HEAD + done, 0) != 0 || fwrite(buf, k, 1, fp) != 1)
+		goto out;
+    }
+    if (fflush(fp) != 0 || !sc_head(fp, n, (long) SC_HEAD, SC_HEAD + size))
+	goto out;
+    sc_base = SC_HEAD;
+    sc_tail = SC_HEAD + size;
+    if (md_ftruncate(fp, sc_tail) == 0)
+	sc_head(fp, n, sc_base, 0L);
+    goto out;
+undo:
+    if (md_ftruncate(fp, end) == 0)
+	sc_head(fp, sc_nsort, sc_base, 0L);
+out:
+    free(tl);
+    free(keys);
+}
+
+/*
+ * sc_open:
+ *	Open and lock the score file and see how it is laid out, taking
+ *	in an old top ten list if that is what is there.
+ */
+
+static FILE *
+sc_open()
+{
+    register FILE *fp;
+    register int i;
+    char buf[SC_HEAD];
+    struct sc_ent old;
+    int rogue_ver = 0, scorefile_ver = 0, n = 0;
+    long len, base = SC_HEAD, clip = 0;
+
+    if ((fp = fopen(SCOREFILE, "r+b")) == NULL)
+	return NULL;
+    md_lockfile(fp);
+    fseek(fp, 0L, 2);
+    if ((len = ftell(fp)) < SC_HEAD)
+    {
+	if (len != 0)
+	    goto bad;
+	sc_head(fp, 0, (long) SC_HEAD, 0L);
+	len = SC_HEAD;
+    }
+    else
+    {
+	fseek(fp, 0L, 0);
+	if (fread(buf, SC_HEAD, 1, fp) != 1)
+	    goto bad;
+	enccrypt(buf, SC_HEAD);
+	buf[SC_HEAD-1] = '\0';
+	sscanf(buf, "R%d %d %d %ld %ld\n", &rogue_ver, &scorefile_ver, &n,
+	    &base, &clip);
+	if (rogue_ver != 36 || scorefile_ver < 2 || scorefile_ver > 4 || n < 0
+	    || base < SC_HEAD)
+		goto bad;
+	/*
+	 * A compaction that stopped before it could cut the file back
+	 */
+	if (clip != 0)
+	{
+	    if (md_ftruncate(fp, clip) != 0 || !sc_head(fp, n, base, 0L))
+		goto bad;
+	    len = clip;
+	}
+    }
+    sc_nsort = n;
+    sc_base = base;
+    sc_tail = sc_pos(n) + 8L * n;
+    sc_ntail = (len < sc_tail) ? 0 : (len - sc_tail) / SC_SIZE;
+    if (scorefile_ver == 2)
+    {
+	/*
+	 * Ten entries of separately encrypted name, login and numbers
+	 */
+	sc_ntail = 0;
+	for (i = 0; i < 10; i++)
+	{
+	    if (fseek(fp, SC_HEAD + i * 188L, 0) != 0
+		|| fread(buf, 88, 1, fp) != 1)
+		    break;
+	    enccrypt(buf, 80);
+	    enccrypt(&buf[80], 8);
+	    memcpy(old.sc_name, buf, 80);
+	    old.sc_name[79] = '\0';
+	    memcpy(old.sc_login, &buf[80], 8);
+	    old.sc_login[8] = '\0';
+	    if (fread(buf, 100, 1, fp) != 1)
+		break;
+	    enccrypt(buf, 100);
+	    buf[99] = '\0';
+	    old.sc_score = 0;
+	    sscanf(buf, " %d %d %d %d \n", &old.sc_score, &old.sc_flags,
+		&old.sc_level, &old.sc_monster);
+	    if (old.sc_score <= 0 || old.sc_flags < 0 || old.sc_flags > 2)
+		continue;
+	    old.sc_time = i;
+	    sc_put(fp, SC_HEAD + (10 + sc_ntail++) * 188L, &old);
+	}
+	/*
+	 * Park them past the old list, then pull them down as the tail
+	 */
+	for (i = 0; i < sc_ntail; i++)
+	{
+	    sc_get(fp, SC_HEAD + (10 + i) * 188L, &old);
+	    sc_put(fp, sc_pos(i), &old);
+	}
+	sc_head(fp, 0, sc_base, 0L);
+	md_ftruncate(fp, sc_pos(sc_ntail));
+	sc_compact(fp);
+    }
+    return fp;
+bad:
+    md_unlockfile(fp);
+    fclose(fp);
+    return NULL;
+}
+
+static void
+sc_close(fp)
+FILE *fp;
+{
+    md_unlockfile(fp);
+    fclose(fp);
+}
+
+/*
+ * sc_find:
+ *	First place in an index at or past a login or level
+ */
+
+static int
+sc_find(fp, which, login, lev)
+FILE *fp;
+int which;
+char *login;
+int lev;
+{
+    register int lo, hi, mid, c;
+    struct sc_ent cur;
+
+    lo = 0;
+    hi = sc_nsort;
+    while (lo < hi)
+    {
+	mid = (lo + hi) / 2;
+	if (!sc_get(fp, sc_pos(sc_idx(fp, which, mid)), &cur))
+	    return sc_nsort;
+	if (which == 0)
+	    c = strcmp(cur.sc_login, login);
+	else
+	    c = cur.sc_level - lev;
+	if (c < 0)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    return lo;
+}
+
+/*
+ * sc_match:
+ *	See if an entry is one being asked for
+ */
+
+static int
+sc_match(scp, login, lev)
+register struct sc_ent *scp;
+char *login;
+int lev;
+{
+    if (scp->sc_flags == SC_GONE)
+	return FALSE;
+    if (login != NULL && strcmp(scp->sc_login, login) != 0)
+	return FALSE;
+    return (lev == 0 || scp->sc_level == lev);
+}
+
+/*
+ * sc_top:
+ *	The best n entries, maybe only for one login or one level.
+ *	The sorted part is walked through an index and stops at n; the
+ *	tail is short enough to look at all of.
+ */
+
+static int
+sc_top(fp, n, login, lev, top)
+FILE *fp;
+int n;
+char *login;
+int lev;
+struct sc_ent *top;
+{
+    register struct sc_ent *tl, *st;
+    register int i, j, k, nt, ns;
+    int which, rec;
+    struct sc_ent cur;
+
+    tl = malloc((sc_ntail + 1) * sizeof *tl);
+    st = malloc((n + 1) * sizeof *st);
+    if (tl == NULL || st == NULL)
+    {
+	free(tl);
+	free(st);
+	return 0;
+    }
+    for (i = nt = 0; i < sc_ntail; i++)
+	if (sc_get(fp, sc_tail + (long) i * SC_SIZE, &tl[nt])
+	    && sc_match(&tl[nt], login, lev))
+		nt++;
+    qsort(tl, nt, sizeof *tl, sc_cmp);
+    which = (login != NULL) ? 0 : (lev != 0) ? 1 : -1;
+    i = (which < 0) ? 0 : sc_find(fp, which, login, lev);
+    for (ns = 0; ns < n && i < sc_nsort; i++)
+    {
+	rec = (which < 0) ? i : sc_idx(fp, which, i);
+	if (!sc_get(fp, sc_pos(rec), &cur))
+	    continue;
+	if (which == 0 && strcmp(cur.sc_login, login) != 0)
+	    break;
+	if (which == 1 && cur.sc_level != lev)
+	    break;
+	if (sc_match(&cur, login, lev))
+	    st[ns++] = cur;
+    }
+    for (i = j = k = 0; k < n && (i < ns || j < nt); k++)
+	if (j >= nt || (i < ns && sc_cmp(&st[i], &tl[j]) < 0))
+	    top[k] = st[i++];
+	else
+	    top[k] = tl[j++];
+    free(tl);
+    free(st);
+    return k;
+}
+
+/*
+ * sc_print:
+ *	Print the best n, with logins or a chance to edit for wizards
+ */
+
+static void
+sc_print(fp, n, login, lev, prflags)
+FILE *fp;
+int n;
+char *login;
+int lev;
+int prflags;
+{
+    register struct sc_ent *scp, *top;
+    register char *killer;
+    register int k;
+
+    if ((top = malloc((n + 1) * sizeof *top)) == NULL)
+	return;
+    k = sc_top(fp, n, login, lev, top);
+    if (n == 10 && login == NULL && lev == 0)
+	printf("\nTop Ten Adventurers:\nRank\tScore\tName\n");
+    else
+	printf("\nRank\tScore\tName\n");
+    for (scp = top; scp < &top[k]; scp++)
+    {
+	printf("%ld\t%d\t%s: %s on level %d", (long) (scp - top + 1),
+	    scp->sc_score, scp->sc_name, reason[scp->sc_flags],
+	    scp->sc_level);
+	if (scp->sc_flags == 0) {
+	    printf(" by a");
+	    killer = killname(scp->sc_monster);
+	    if (*killer == 'a' || *killer == 'e' || *killer == 'i' ||
+		*killer == 'o' || *killer == 'u')
+		    putchar('n');
+	    printf(" %s", killer);
+	}
+	if (prflags == 1)
+	{
+	    printf(" (%s)", scp->sc_login);
+	    putchar('\n');
+	}
+	else if (prflags == 2)
+	{
+	    fflush(stdout);
+	    if (fgets(prbuf,sizeof(prbuf),stdin) == NULL)
+		prbuf[0] = 0;
+	    if (prbuf[0] == 'd')
+	    {
+		scp->sc_flags = SC_GONE;
+		sc_put(fp, scp->sc_where, scp);
+	    }
+	}
+	else
+	    printf(".\n");
+    }
+    free(top);
+}
+
+/*
+ * The statistics file is a hash table of players on login, opened
+ * up like the score file.  A header has the size of the table, how
+ * full it is and where in the file it starts; each slot is a login
+ * and a row of counters kept as 8 byte little endian numbers.  An
+ * empty login is a free slot.
+ */
+
+#define ST_HEAD		16		/* magic, slots, slots used, start */
+#define ST_GAMES	0		/* games finished */
+#define ST_DIED		1		/* ... by being killed */
+#define ST_QUIT		2		/* ... by quitting */
+#define ST_WON		3		/* ... with the amulet */
+#define ST_DEPTH	4		/* deepest level reached */
+#define ST_GOLD		5		/* gold over all games */
+#define ST_BEST		6		/* most gold in a game */
+#define ST_TURNS	7		/* turns over all games */
+#define ST_KILLER	8		/* deaths by each killer from here */
+#define ST_NKILL	29		/* A-Z, arrow, dart and bolt */
+#define ST_NUM		(ST_KILLER + ST_NKILL)
+#define ST_SIZE		(16 + ST_NUM * 8)
+#define ST_START	64		/* slots in a new table */
+
+#define st_pos(i)	(st_base + (long) (i) * ST_SIZE)
+
+struct st_ent {
+    char st_login[16];
+    unsigned long st_num[ST_NUM];
+};
+
+static int st_slots, st_used;
+static long st_base;			/* Where the table starts */
+
+static int
+st_get(fp, i, stp)
+FILE *fp;
+int i;
+register struct st_ent *stp;
+{
+    unsigned char buf[ST_SIZE];
+    register unsigned char *bp;
+    register int f, b;
+
+    if (fseek(fp, st_pos(i), 0) != 0 || fread(buf, ST_SIZE, 1, fp) != 1)
+	return FALSE;
+    memcpy(stp->st_login, buf, 16);
+    stp->st_login[15] = '\0';
+    for (f = 0, bp = &buf[16]; f < ST_NUM; f++, bp += 8)
+	for (stp->st_num[f] = 0, b = 7; b >= 0; b--)
+	    stp->st_num[f] = (stp->st_num[f] << 8) | bp[b];
+    return TRUE;
+}
+
+static int
+st_put(fp, i, stp)
+FILE *fp;
+int i;
+register struct st_ent *stp;
+{
+    unsigned char buf[ST_SIZE];
+    register unsigned char *bp;
+    register unsigned long v;
+    register int f, b;
+
+    memset(buf, 0, ST_SIZE);
+    memcpy(buf, stp->st_login, strlen(stp->st_login));
+    for (f = 0, bp = &buf[16]; f < ST_NUM; f++, bp += 8)
+	for (v = stp->st_num[f], b = 0; b < 8; b++, v >>= 8)
+	    bp[b] = v & 0xff;
+    return (fseek(fp, st_pos(i), 0) == 0 && fwrite(buf, ST_SIZE, 1, fp) == 1);
+}
+
+static int
+st_head(fp)
+FILE *fp;
+{
+    unsigned char buf[ST_HEAD];
+    register int i;
+
+    memset(buf, 0, ST_HEAD);
+    memcpy(buf, "R36u", 4);
+    for (i = 0; i < 4; i++)
+    {
+	buf[4 + i] = (st_slots >> (8 * i)) & 0xff;
+	buf[8 + i] = (st_used >> (8 * i)) & 0xff;
+	buf[12 + i] = (st_base >> (8 * i)) & 0xff;
+    }
+    return (fseek(fp, 0L, 0) == 0 && fwrite(buf, ST_HEAD, 1, fp) == 1
+	&& fflush(fp) == 0);
+}
+
+/*
+ * st_find:
+ *	Slot a login is in, or the free one it would go in
+ */
+
+static int
+st_find(fp, login, stp)
+FILE *fp;
+char *login;
+register struct st_ent *stp;
+{
+    register unsigned long h;
+    register char *sp;
+    register int i, n;
+    char key[16];
+
+    strncpy(key, login, 15);
+    key[15] = '\0';
+    for (h = 2166136261UL, sp = key; *sp; sp++)
+	h = ((h ^ (unsigned char) *sp) * 16777619UL) & 0xffffffffUL;
+    for (i = h % st_slots, n = 0; n < st_slots; i = (i + 1) % st_slots, n++)
+    {
+	if (!st_get(fp, i, stp))
+	    memset(stp, 0, sizeof *stp);
+	if (stp->st_login[0] == '\0' || strcmp(stp->st_login, key) == 0)
+	    return i;
+    }
+    return -1;
+}
+
+/*
+ * st_grow:
+ *	Double the table once it is three quarters full.  The new one is
+ *	built past the end of the file and only the header, written
+ *	last, makes it the table, so dying part way loses nothing.  The
+ *	old one is left where it was.
+ */
+
+static int
+st_grow(fp)
+FILE *fp;
+{
+    register struct st_ent *all;
+    register int i, n;
+    struct st_ent cur;
+    int slots;
+    long base;
+
+    if ((all = malloc((st_used + 1) * sizeof *all)) == NULL)
+	return FALSE;
+    for (i = n = 0; i < st_slots && n < st_used; i++)
+	if (st_get(fp, i, &all[n]) && all[n].st_login[0] != '\0')
+	    n++;
+    slots = st_slots;
+    base = st_base;
+    st_base = st_pos(st_slots);
+    st_slots *= 2;
+    if (md_ftruncate(fp, st_base) != 0 || md_ftruncate(fp, st_pos(st_slots)) != 0)
+	goto bad;
+    for (i = 0; i < n; i++)
+	if (!st_put(fp, st_find(fp, all[i].st_login, &cur), &all[i]))
+	    goto bad;
+    if (fflush(fp) != 0)
+	goto bad;
+    free(all);
+    st_used = n;
+    return st_head(fp);
+bad:
+    free(all);
+    st_slots = slots;
+    st_base = base;
+    return FALSE;
+}
+
+/*
+ * st_open:
+ *	Open and lock the statistics file, making a table if it is empty
+ */
+
+static FILE *
+st_open()
+{
+    register FILE *fp;
+    unsigned char buf[ST_HEAD];
+    register int i, fd;
+
+    if ((fd = open(STATFILE, O_RDWR | O_CREAT, 0664)) < 0)
+	return NULL;
+    if ((fp = fdopen(fd, "r+b")) == NULL)
+    {
+	close(fd);
+	return NULL;
+    }
+    md_lockfile(fp);
+    if (fread(buf, ST_HEAD, 1, fp) != 1)
+    {
+	st_slots = ST_START;
+	st_used = 0;
+	st_base = ST_HEAD;
+	if (md_ftruncate(fp, st_pos(st_slots)) == 0 && st_head(fp))
+	    return fp;
+    }
+    else if (memcmp(buf, "R36u", 4) == 0)
+    {
+	for (st_slots = st_used = 0, st_base = 0, i = 3; i >= 0; i--)
+	{
+	    st_slots = (st_slots << 8) | buf[4 + i];
+	    st_used = (st_used << 8) | buf[8 + i];
+	    st_base = (st_base << 8) | buf[12 + i];
+	}
+	if (st_base == 0)		/* from before the table could move */
+	    st_base = ST_HEAD;
+	if (st_slots > 0 && st_used < st_slots)
+	    return fp;
+    }
+    md_unlockfile(fp);
+    fclose(fp);
+    return NULL;
+}
+
+/*
+ * add_stats:
+ *	Count a finished game for the player
+ */
+
+static void
+add_stats(amount, flags, monst)
 int amount;
 int flags;
 char monst;
 {
-    static struct sc_ent {
-	int sc_score;
-	char sc_name[80];
-	int sc_flags;
-	int sc_level;
-	char sc_login[9];
-	int sc_monster;
-    } top_ten[10];
-    register struct sc_ent *scp;
+    register FILE *fp;
     register int i;
-    register struct sc_ent *sc2;
-    register FILE *outf;
-    register char *killer;
-    register int prflags = 0;
-    register int fd;
-    static char *reason[] = {
-	"killed",
-	"quit",
-	"A total winner",
-    };
-    char scoreline[100];
-    int rogue_ver = 0, scorefile_ver = 0;
+    register unsigned long *np;
+    struct st_ent cur;
+    char *login;
 
-    if (flags != -1)
-	endwin();
+    if ((login = md_getusername()) == NULL || (fp = st_open()) == NULL)
+	return;
+    if ((st_used + 1) * 4 > st_slots * 3)
+	st_grow(fp);
+    if ((i = st_find(fp, login, &cur)) >= 0)
+    {
+	if (cur.st_login[0] == '\0')
+	{
+	    strncpy(cur.st_login, login, 15);
+	    cur.st_login[15] = '\0';
+	    st_used++;
+	    st_head(fp);
+	}
+	np = cur.st_num;
+	np[ST_GAMES]++;
+	np[flags == 0 ? ST_DIED : flags == 1 ? ST_QUIT : ST_WON]++;
+	if ((unsigned long) max_level > np[ST_DEPTH])
+	    np[ST_DEPTH] = max_level;
+	np[ST_GOLD] += amount;
+	if ((unsigned long) amount > np[ST_BEST])
+	    np[ST_BEST] = amount;
+	np[ST_TURNS] += turns;
+	if (flags == 0)
+	{
+	    if (isupper(monst))
+		np[ST_KILLER + monst - 'A']++;
+	    else if (monst == 'a')
+		np[ST_KILLER + 26]++;
+	    else if (monst == 'd')
+		np[ST_KILLER + 27]++;
+	    else if (monst == 'b')
+		np[ST_KILLER + 28]++;
+	}
+	st_put(fp, i, &cur);
+    }
+    md_unlockfile(fp);
+    fclose(fp);
+}
+
+static void
+st_print(stp)
+register struct st_ent *stp;
+{
+    register unsigned long *np = stp->st_num;
+    register int k;
+    register char *sep = "";
+
+    printf("%s\t%lu\t%lu\t%lu\t%lu\t%lu\t%lu\t%lu\t%lu\t", stp->st_login,
+	np[ST_GAMES], np[ST_DIED], np[ST_QUIT], np[ST_WON], np[ST_DEPTH],
+	np[ST_GOLD], np[ST_BEST], np[ST_TURNS]);
+    for (k = 0; k < ST_NKILL; k++)
+	if (np[ST_KILLER + k] != 0)
+	{
+	    printf("%s%s:%lu", sep,
+		killname(k < 26 ? 'A' + k : "adb"[k - 26]), np[ST_KILLER + k]);
+	    sep = ",";
+	}
+    putchar('\n');
+}
+
+/*
+ * show_stats:
+ *	Print a tab separated line for one player or for all of them:
+ *	login, games, deaths, quits, wins, deepest level, gold, most
+ *	gold, turns and what killed him how often.
+ */
+
+void
+show_stats(login)
+char *login;
+{
+    register FILE *fp;
+    register int i;
+    struct st_ent cur;
+
+    if ((fp = st_open()) == NULL)
+	return;
+    if (login != NULL)
+    {
+	if ((i = st_find(fp, login, &cur)) >= 0 && cur.st_login[0] != '\0')
+	    st_print(&cur);
+    }
+    else
+	for (i = 0; i < st_slots; i++)
+	    if (st_get(fp, i, &cur) && cur.st_login[0] != '\0')
+		st_print(&cur);
+    md_unlockfile(fp);
+    fclose(fp);
+}
+
+/*
+ * The results file has a row for each game that ends, for batch runs,
+ * stored by column so a few columns can be read without the rest.
+ * After a header naming the columns come groups of R_ROWS rows; in
+ * each group every column is kept together, as little endian numbers
+ * of its width.  The header says how many rows there are.
+ */
+
+#define R_ROWS	1024			/* rows in a group */
+
+static struct res_col {
+    char *c_name;
+    int c_width;
+} res_cols[] = {
+    { "seed",	4 },
+    { "end",	1 },			/* 0 killed, 1 quit, 2 won */
+    { "killer",	1 },			/* killname() letter */
+    { "turns",	4 },
+    { "level",	4 },
+    { "depth",	4 },
+    { "gold",	4 },
+    { "rank",	4 },			/* pstats.s_lvl */
+    { "exp",	4 },
+    { "hp",	4 },
+    { "maxhp",	4 },
+    { "str",	2 },
+    { "stradd",	2 },
+    { "maxstr",	2 },
+    { "ac",	2 },
+    { "weapon",	2 },			/* o_which, -1 for none */
+    { "hplus",	2 },
+    { "dplus",	2 },
+    { "armor",	2 },
+    { "ring1",	2 },
+    { "ring2",	2 },
+};
+
+#define R_COLS	(sizeof res_cols / sizeof res_cols[0])
+#define R_HEAD	(12 + R_COLS * 8)	/* magic, columns, rows, then names */
+
+static void
+res_put(buf, v, width)
+register unsigned char *buf;
+register long v;
+register int width;
+{
+    while (width--)
+    {
+	*buf++ = v & 0xff;
+	v >>= 8;
+    }
+}
+
+static long
+res_get(buf, width)
+register unsigned char *buf;
+register int width;
+{
+    register unsigned long v = 0;
+    register int i;
+
+    for (i = width - 1; i >= 0; i--)
+	v = (v << 8) | buf[i];
+    if (width < (int) sizeof v && (buf[width - 1] & 0x80))
+	v -= 1UL << (8 * width);
+    return (long) v;
+}
+
+/*
+ * res_open:
+ *	Open and lock a results file, setting it up if it is empty.
+ *	Returns the number of rows or -1.
+ */
+
+static long
+res_open(file, fpp, create)
+char *file;
+FILE **fpp;
+bool create;
+{
+    register FILE *fp;
+    register int i, fd;
+    unsigned char head[R_HEAD];
+    long rows;
+
+    if ((fd = open(file, create ? O_RDWR | O_CREAT : O_RDONLY, 0664)) < 0)
+	return -1;
+    if ((fp = fdopen(fd, create ? "r+b" : "rb")) == NULL)
+    {
+	close(fd);
+	return -1;
+    }
+    if (create)
+	md_lockfile(fp);
+    if (fread(head, R_HEAD, 1, fp) != 1)
+    {
+	memset(head, 0, R_HEAD);
+	memcpy(head, "R36c", 4);
+	res_put(&head[4], (long) R_COLS, 4);
+	for (i = 0; i < (int) R_COLS; i++)
+	{
+	    strncpy((char *) &head[12 + i * 8], res_cols[i].c_name, 7);
+	    head[12 + i * 8 + 7] = res_cols[i].c_width;
+	}
+	if (!create || fseek(fp, 0L, 0) != 0 || fwrite(head, R_HEAD, 1, fp) != 1)
+	    goto bad;
+    }
+    else if (memcmp(head, "R36c", 4) != 0 || res_get(&head[4], 4) != R_COLS)
+	goto bad;
+    rows = res_get(&head[8], 4);
+    *fpp = fp;
+    return rows;
+bad:
+    if (create)
+	md_unlockfile(fp);
+    fclose(fp);
+    return -1;
+}
+
+/*
+ * res_where:
+ *	Where a column of a group starts
+ */
+
+static long
+res_where(group, col)
+long group;
+int col;
+{
+    register int i, before, all;
+
+    for (i = before = all = 0; i < (int) R_COLS; i++)
+    {
+	if (i < col)
+	    before += res_cols[i].c_width;
+	all += res_cols[i].c_width;
+    }
+    return R_HEAD + group * all * R_ROWS + (long) before * R_ROWS;
+}
+
+/*
+ * add_result:
+ *	Add a row for the game just ended
+ */
+
+static void
+add_result(amount, flags, monst)
+int amount;
+int flags;
+char monst;
+{
+    FILE *fp;
+    register int i, w;
+    long row, v[R_COLS];
+    unsigned char buf[8];
+
+    if (res_file[0] == '\0' || (row = res_open(res_file, &fp, TRUE)) < 0)
+	return;
+    v[0] = dnum;
+    v[1] = flags;
+    v[2] = (flags == 0) ? monst : 0;
+    v[3] = turns;
+    v[4] = level;
+    v[5] = max_level;
+    v[6] = amount;
+    v[7] = pstats.s_lvl;
+    v[8] = pstats.s_exp;
+    v[9] = pstats.s_hpt;
+    v[10] = max_stats.s_hpt;
+    v[11] = pstats.s_str.st_str;
+    v[12] = pstats.s_str.st_add;
+    v[13] = max_stats.s_str.st_str;
+    v[14] = (cur_armor != NULL) ? cur_armor->o_ac : pstats.s_arm;
+    v[15] = (cur_weapon != NULL) ? cur_weapon->o_which : -1;
+    v[16] = (cur_weapon != NULL) ? cur_weapon->o_hplus : 0;
+    v[17] = (cur_weapon != NULL) ? cur_weapon->o_dplus : 0;
+    v[18] = (cur_armor != NULL) ? cur_armor->o_which : -1;
+    v[19] = (cur_ring[LEFT] != NULL) ? cur_ring[LEFT]->o_which : -1;
+    v[20] = (cur_ring[RIGHT] != NULL) ? cur_ring[RIGHT]->o_which : -1;
     /*
-     * Open file and read list
+     * A new group is added whole, so its columns read back as zeros
      */
+    if (row % R_ROWS == 0)
+	md_ftruncate(fp, res_where(row / R_ROWS + 1, 0));
+    for (i = 0; i < (int) R_COLS; i++)
+    {
+	w = res_cols[i].c_width;
+	res_put(buf, v[i], w);
+	if (fseek(fp, res_where(row / R_ROWS, i) + (row % R_ROWS) * w, 0) != 0
+	    || fwrite(buf, w, 1, fp) != 1)
+		goto done;
+    }
+    res_put(buf, row + 1, 4);
+    if (fseek(fp, 8L, 0) == 0)
+	fwrite(buf, 4, 1, fp);
+done:
+    md_unlockfile(fp);
+    fclose(fp);
+}
+
+/*
+ * show_results:
+ *	Print some columns of a results file, tab separated, reading
+ *	only those columns
+ */
 
-    if ((fd = open(SCOREFILE, 2)) < 0)
+void
+show_results(file, names)
+char *file;
+char **names;
+{
+    FILE *fp;
+    register int i, k, w, ncol, n;
+    bool all;
+    long row, rows, group;
+    int cols[R_COLS];
+    unsigned char *data[R_COLS];
+
+    if ((rows = res_open(file, &fp, FALSE)) < 0)
+    {
+	printf("%s: not a results file\n", file);
 	return;
-    outf = fdopen(fd, "w");
+    }
+    all = (*names == NULL);		/* none named means all of them */
+    for (ncol = 0; ncol < (int) R_COLS && (all || names[ncol] != NULL); )
+    {
+	if (all)
+	    i = ncol;
+	else
+	    for (i = 0; i < (int) R_COLS; i++)
+		if (strcmp(names[ncol], res_cols[i].c_name) == 0)
+		    break;
+	if (i == R_COLS)
+	{
+	    printf("%s: no such column\n", names[ncol]);
+	    goto done;
+	}
+	cols[ncol] = i;
+	if ((data[ncol++] = malloc(R_ROWS * res_cols[i].c_width)) == NULL)
+	    break;
+    }
+    for (k = 0; k < ncol; k++)
+	printf("%s%c", res_cols[cols[k]].c_name, (k == ncol - 1) ? '\n' : '\t');
+    for (group = 0; group * R_ROWS < rows; group++)
+    {
+	n = (rows - group * R_ROWS < R_ROWS) ? rows - group * R_ROWS : R_ROWS;
+	for (k = 0; k < ncol; k++)
+	    if (data[k] == NULL || fseek(fp, res_where(group, cols[k]), 0) != 0
+		|| fread(data[k], res_cols[cols[k]].c_width, n, fp) != (size_t) n)
+		    goto done;
+	for (row = 0; row < n; row++)
+	    for (k = 0; k < ncol; k++)
+	    {
+		w = res_cols[cols[k]].c_width;
+		printf("%ld%c", res_get(&data[k][row * w], w),
+		    (k == ncol - 1) ? '\n' : '\t');
+	    }
+    }
+done:
+    for (k = 0; k < ncol; k++)
+	free(data[k]);
+    fclose(fp);
+}
 
-    for (scp = top_ten; scp <= &top_ten[9]; scp++)
+/*
+ * scores:
+ *	Show the score file from the command line
+ */
+
+void
+scores(n, login, lev)
+int n;
+char *login;
+int lev;
+{
+    register FILE *fp;
+    char who[16];
+
+    if ((fp = sc_open()) == NULL)
+	return;
+    if (login != NULL)
     {
-	scp->sc_score = 0;
-	for (i = 0; i < 80; i++)
-	    scp->sc_name[i] = rnd(255);
-	scp->sc_flags = RN;
-	scp->sc_level = RN;
-	scp->sc_monster = RN;
-	scp->sc_login[0] = '\0';
+	strncpy(who, login, 15);
+	who[15] = '\0';
+	login = who;
     }
+    sc_print(fp, n, login, lev, 0);
+    sc_close(fp);
+}
+
+/*
+ * score -- figure score and post it.
+ */
+
+/* VARARGS2 */
+void
+score(amount, flags, monst)
+int amount;
+int flags;
+char monst;
+{
+    register FILE *fp;
+    register int prflags = 0;
+    register int pid;
+    struct sc_ent here;
+    time_t now;
+
+    if (flags != -1)
+	scr_close();
 
     signal(SIGINT, SIG_DFL);
     if ((flags != -1) && (flags != 1))
@@ -136,7 +1279,7 @@ char monst;
 	draw(stdscr);
 	prbuf[0] = 0;
 	get_str(prbuf, stdscr);
-	endwin();
+	scr_close();
     }
     if (wizard)
 	if (strcmp(prbuf, "names") == 0)
@@ -144,107 +1287,56 @@ char monst;
 	else if (strcmp(prbuf, "edit") == 0)
 	    prflags = 2;
 
-	encread(scoreline, 100, fd);
-	sscanf(scoreline, "R%d %d\n", &rogue_ver, &scorefile_ver);
-
-	if ((rogue_ver == 36) && (scorefile_ver == 2))
-	    for(i = 0; i < 10; i++)
-	    {
-		encread((char *) &top_ten[i].sc_name, 80, fd);
-		encread((char *) &top_ten[i].sc_login, 8, fd);
-		top_ten[i].sc_login[8] = 0;
-		encread(scoreline, 100, fd);
-		sscanf(scoreline, " %d %d %d %d \n",
-		    &top_ten[i].sc_score,  &top_ten[i].sc_flags,
-		    &top_ten[i].sc_level,  &top_ten[i].sc_monster);
-	    }
-
+    if (flags != -1)
+	add_result(amount, flags, monst);
+    if (flags != -1 && !waswizard)
+	add_stats(amount, flags, monst);
+    if ((fp = sc_open()) == NULL)
+	return;
     /*
-     * Insert her in list if need be
+     * Add her to the end of the log
      */
-    if (!waswizard)
+    if (!waswizard && amount > 0)
     {
-	for (scp = top_ten; scp <= &top_ten[9]; scp++)
-	    if (amount > scp->sc_score)
-		break;
-	if (scp <= &top_ten[9])
-	{
-	    for (sc2 = &top_ten[9]; sc2 > scp; sc2--)
-		*sc2 = *(sc2-1);
-	    scp->sc_score = amount;
-	    strcpy(scp->sc_name, whoami);
-	    scp->sc_flags = flags;
-	    if (flags == 2)
-		scp->sc_level = max_level;
-	    else
-		scp->sc_level = level;
-	    scp->sc_monster = monst;
-	    strncpy(scp->sc_login, md_getusername(), 8);
-	    scp->sc_login[8] = '\0';
-	}
+	here.sc_score = amount;
+	strncpy(here.sc_name, whoami, 79);
+	here.sc_name[79] = '\0';
+	here.sc_flags = flags;
+	if (flags == 2)
+	    here.sc_level = max_level;
+	else
+	    here.sc_level = level;
+	here.sc_monster = monst;
+	strncpy(here.sc_login, md_getusername(), 15);
+	here.sc_login[15] = '\0';
+	time(&now);
+	here.sc_time = (long) now;
+	if (sc_put(fp, sc_tail + (long) sc_ntail * SC_SIZE, &here))
+	    sc_ntail++;
     }
-    /*
-     * Print the list
-     */
-    printf("\nTop Ten Adventurers:\nRank\tScore\tName\n");
-    for (scp = top_ten; scp <= &top_ten[9]; scp++) {
-	if (scp->sc_score) {
-	    printf("%ld\t%d\t%s: %s on level %d", scp - top_ten + 1,
-		scp->sc_score, scp->sc_name, reason[scp->sc_flags],
-		scp->sc_level);
-	    if (scp->sc_flags == 0) {
-		printf(" by a");
-		killer = killname(scp->sc_monster);
-		if (*killer == 'a' || *killer == 'e' || *killer == 'i' ||
-		    *killer == 'o' || *killer == 'u')
-			putchar('n');
-		printf(" %s", killer);
-	    }
-	    if (prflags == 1)
-	    {
-		printf(" (%s)", scp->sc_login);
-		putchar('\n');
-	    }
-	    else if (prflags == 2)
-	    {
-		fflush(stdout);
-		if (fgets(prbuf,sizeof(prbuf),stdin) == NULL)
-		    prbuf[0] = 0;
-		if (prbuf[0] == 'd')
-		{
-		    for (sc2 = scp; sc2 < &top_ten[9]; sc2++)
-			*sc2 = *(sc2 + 1);
-		    top_ten[9].sc_score = 0;
-		    for (i = 0; i < 80; i++)
-			top_ten[9].sc_name[i] = rnd(255);
-		    top_ten[9].sc_flags = RN;
-		    top_ten[9].sc_level = RN;
-		    top_ten[9].sc_monster = RN;
-		    scp--;
-		}
-	    }
-	    else
-		printf(".\n");
-	}
+    sc_print(fp, 10, NULL, 0, prflags);
+    fflush(stdout);
+    if (sc_ntail < SC_TAIL)
+    {
+	sc_close(fp);
+	return;
     }
-    fseek(outf, 0L, 0);
     /*
-     * Update the list file
+     * The tail is long, so fold it in, out of the player's way if we can
      */
-    memset(scoreline,0,100);
-    sprintf(scoreline, "R36 %d\n", 2);
-    encwrite(scoreline, 100, outf);
-    for(i = 0; i < 10; i++)
+    sc_close(fp);
+    if ((pid = md_fork()) > 0)
+	return;
+    if (pid == 0)
+	md_ignoreallsignals();
+    if ((fp = sc_open()) != NULL)
     {
-	encwrite((char *)&top_ten[i].sc_name, 80, outf);
-	encwrite((char *)&top_ten[i].sc_login, 8, outf);
-	memset(scoreline,0,100);
-	sprintf(scoreline, " %d %d %d %d \n",
-	    top_ten[i].sc_score,  top_ten[i].sc_flags,
-	    top_ten[i].sc_level,  top_ten[i].sc_monster);
-	encwrite(scoreline, 100, outf);
+	if (sc_ntail >= SC_TAIL)
+	    sc_compact(fp);
+	sc_close(fp);
     }
-    fclose(outf);
+    if (pid == 0)
+	_exit(0);
 }
 
 int
@@ -256,6 +1348,8 @@ total_winner()
     register char c;
     register int oldpurse;
 
+    drop_checkpoint();
+    rec_close();
     clear();
     standout();
     addstr("                                                               \n");
@@ -273,7 +1367,7 @@ total_winner()
     addstr("Dungeons of Doom alive.  You journey home and sell all your loot at\n");
     addstr("a great profit and are admitted to the fighters guild.\n");
     mvaddstr(LINES - 1, 0, "--Press space to continue--");
-    refresh();
+    draw(stdscr);
     wait_for(stdscr, ' ');
     clear();
     mvaddstr(0, 0, "   Worth  Item");
@@ -346,11 +1440,13 @@ total_winner()
 	    when AMULET:
 		worth = 1000;
 	}
+	newnames();
 	mvprintw(c - 'a' + 1, 0, "%c) %5d  %s", c, worth, inv_name(obj, FALSE));
 	purse += worth;
     }
     mvprintw(c - 'a' + 1, 0,"   %5d  Gold Peices          ", oldpurse);
-    refresh();
+    draw(stdscr);
+    event("win", "\"gold\":%d", purse);
     score(purse, 2, 0);
     exit(0);
 }
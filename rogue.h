@@ -14,7 +14,10 @@
 #define MAXOBJ 9
 #define MAXPACK 23
 #define MAXTRAPS 10
+#define RS_FORMAT 5	/* save file format, see state.c */
+#define RS_STAT_SIZE 28	/* stat record on the end of a save file */
 #define	NUMTHINGS 7	/* number of types of things (scrolls, rings, etc.) */
+#define REST_MAX 1000	/* longest rest until healed, in turns */
 
 /*
  * return values for get functions
@@ -42,7 +45,7 @@
 #define otherwise break;default
 #define until(expr) while(!(expr))
 #define ce(a, b) ((a).x == (b).x && (a).y == (b).y)
-#define draw(window) wrefresh(window)
+#define draw(window) scr_mark(window)
 #define hero player.t_pos
 #define pstats player.t_stats
 #define pack player.t_pack
@@ -60,6 +63,7 @@
 #define ISRING(h,r) (cur_ring[h] != NULL && cur_ring[h]->o_which == r)
 #define ISWEARING(r) (ISRING(LEFT, r) || ISRING(RIGHT, r))
 #define newgrp() ++group
+#define newnames() ++namegen
 #define o_charges o_ac
 #define ISMULT(type) (type == POTION || type == SCROLL || type == FOOD)
 
@@ -398,6 +402,25 @@ struct object {
     int o_ac;				/* Armor class */
     int o_flags;			/* Information about objects */
     int o_group;			/* Group number for this object */
+    int o_slot;				/* Where it is in the pack index */
+};
+
+/*
+ * A way of putting windows in front of him.  The windows are the game's
+ * picture of the screen; a backend only shows them.  Those that keep
+ * their own copy of the screen are handed the changes as runs through
+ * b_put.
+ */
+
+struct backend {
+    char *b_name;			/* What the screen option calls it */
+    bool b_tty;				/* It draws on the terminal */
+    bool (*b_open)();			/* Start up, FALSE if it can't */
+    int (*b_show)();			/* Bring the screen up to a window */
+    void (*b_put)();			/* Put a run of characters at y, x */
+    int (*b_flush)();			/* Send it, cursor left at y, x */
+    void (*b_clear)();			/* Blank the screen */
+    void (*b_close)();			/* Give the screen back for now */
 };
 
 /*
@@ -406,6 +429,7 @@ struct object {
 
 extern struct room rooms[MAXROOMS];		/* One for each room -- A level */
 extern struct room *oldrp;			/* Roomin(&oldpos) */
+extern struct backend *display;			/* What draw() goes through */
 extern struct linked_list *mlist;		/* List of monsters on the level */
 extern struct thing player;			/* The rogue */
 extern struct stats max_stats;			/* The maximum for the player */
@@ -441,7 +465,13 @@ extern int quiet;				/* Number of quiet turns */
 extern int max_level;				/* Deepest player has gone */
 extern int food_left;				/* Amount of food in hero's stomach */
 extern int group;				/* Current group number */
+extern int namegen;				/* Bumped when item names change */
 extern int hungry_state;			/* How hungry is he */
+extern int autosave;				/* Turns between checkpoints */
+extern int turns;				/* Number of turns played */
+extern int ttymax;				/* Kilobytes per screen recording */
+extern int flyrate;				/* Missile steps shown a second */
+extern int framerate;				/* Screens shown a second when busy */
 
 extern char take;				/* Thing the rogue is taking */
 extern char prbuf[100];			/* Buffer for sprintfs */
@@ -456,13 +486,18 @@ extern char *ws_made[MAXSTICKS];		/* What sticks are made of */
 extern char *release;				/* Release number of rogue */
 extern char whoami[80];			/* Name of player */
 extern char fruit[80];				/* Favorite fruit */
-extern char huh[80];				/* The last message printed */
 extern char *s_guess[MAXSCROLLS];		/* Players guess at what scroll is */
 extern char *p_guess[MAXPOTIONS];		/* Players guess at what potion is */
 extern char *r_guess[MAXRINGS];		/* Players guess at what ring is */
 extern char *ws_guess[MAXSTICKS];		/* Players guess at what wand is */
 extern char *ws_type[MAXSTICKS];		/* Is it a wand or a staff */
 extern char file_name[80];			/* Save file name */
+extern char rec_file[80];			/* Where to record the game */
+extern char tty_file[80];			/* Where to record the screen */
+extern char scr_name[80];			/* How to draw the screen */
+extern char frame_file[80];			/* Where to record frames */
+extern char ev_file[80];			/* Where to write events */
+extern char res_file[80];			/* Where to add the result */
 extern char home[80];				/* User's home directory */
 
 extern WINDOW *cw;				/* Window that the player sees */
@@ -488,6 +523,7 @@ extern bool r_know[MAXRINGS];			/* Does he know what a ring does */
 extern bool ws_know[MAXSTICKS];		/* Does he know what a stick does */
 extern bool amulet;				/* He found the amulet */
 extern bool in_shell;				/* True if executing a shell */
+extern bool headless;				/* No screen, playing a replay */
 
 extern coord oldpos;				/* Position before last look() call */
 extern coord delta;				/* Change indicated to get_dir() */
@@ -532,6 +568,9 @@ extern const int cNMETAL;
 extern int do_daemons(int);
 extern int do_fuses(int);
 extern int pack_char(struct object *);
+extern void pack_index(void);
+extern void del_pack(struct linked_list *);
+extern struct linked_list *pack_item(int);
 extern void take_off();
 extern int dropcheck(struct object *);
 extern int waste_time();
@@ -539,6 +578,8 @@ extern void wear();
 extern void msg(char *, ...);
 extern int addmsg(char *, ...);
 extern int endmsg();
+extern void recall();
+extern void fly_frame();
 extern int rnd(int);
 extern int diag_ok(coord *, coord *);
 int	                encerror(void);
@@ -546,6 +587,7 @@ void                    encseterr(int err);
 int                     encclearerr(void);
 extern int encread(char *, unsigned, int);
 extern int encwrite(char *, unsigned, FILE *);
+extern void enccrypt(char *, unsigned);
 extern int cansee(int, int);
 extern int step_ok(int);
 extern int do_chase(struct thing *);
@@ -561,7 +603,12 @@ extern void identify();
 extern int wait_for(WINDOW *, int);
 extern void help();
 extern void search();
+extern bool disturbed();
+extern int nseen();
 extern void score(int, int, int);
+extern void scores(int, char *, int);
+extern void show_stats(char *);
+extern void show_results(char *, char **);
 extern int add_pass();
 extern int teleport();
 extern int init_weapon(struct object *, int);
@@ -598,6 +645,7 @@ extern int show_win(WINDOW *, char *);
 extern int new_level();
 extern int ring_eat(int);
 extern int light(coord *);
+extern void show_room(struct room *);
 extern void extinguish(void (*)());
 extern int start_daemon(void (*)(), int, int);
 extern int roll(int, int);
@@ -671,6 +719,27 @@ extern int randmonster(int);
 extern int vert(int);
 extern int horiz(int);
 extern int save_file(FILE *);
+extern int write_save(FILE *);
+extern void checkpoint();
+extern void drop_checkpoint();
+extern void snapshot();
+extern void list_saves(char *);
+extern void replay(char *, int);
+extern void replay_seek();
+extern void rec_open();
+extern void rec_frame();
+extern void ev_open();
+extern void event(char *, char *, ...);
+extern void ev_flush();
+extern void tty_open();
+extern void tty_hold();
+extern bool scr_open();
+extern void scr_close();
+extern int scr_mark();
+extern int scr_flush();
+extern bool scr_slow();
+extern bool scr_blind();
+extern void rec_close();
 extern void drain(int, int, int, int);
 extern int save_throw(int, struct thing *);
 extern int hit_monster(int, int, struct object *);
@@ -688,6 +757,9 @@ extern void chmsg(char *fmt, ...);
 #ifdef MAXLOAD
 extern int loadav(double *);
 #endif
-extern int rs_restore_file(FILE *savef);
+extern int rs_restore_image(char *img, size_t len, int version);
 extern int rs_save_file(FILE *savef);
+extern unsigned long rs_digest(void);
+extern char *rs_frame(size_t *len);
+extern int rs_read_frame(char *img, size_t len);
 
@@ -252,7 +252,13 @@ Prints the program version number.
 Quit.  Leave the game.
 .IP R
 Repeat last message.  Useful when a message disappears before you can
-read it.
+read it.  Typing it again straight away shows the one before that, and
+so on back through the last 64 messages.
+.IP Z
+Rest until healed.  You rest until your hit points are back to their
+maximum, stopping early if a monster comes into view or something
+happens that you should know about.  The screen is brought up to date
+when you stop.
 .IP S
 Save the current game in a file.  Caveat: Rogue won't let you start
 up a copy of a saved game, and it removes the save file as soon as
@@ -374,9 +380,20 @@ Useful for those who are tired of the sometimes lengthy messages of rogue.
 This is a useful option for those on slow terminals.  This option defaults to
 on if your are on a slow (under 1200 baud) terminal.
 .IP "jump [nojump]"
-If this option is set, running moves will not be displayed until you
-reach the end of the move.  This saves considerable cpu time and
+If this option is set, running moves and repeated commands will not be
+displayed until they end.  This saves considerable cpu time and
 display time.  This option defaults to on if you are using a slow terminal.
+Either way they stop when a monster comes into view,
+you get hurt or hungrier, or a message comes up.
+.IP "flyrate [0]"
+How many steps a second of a thrown or fired missile's flight are
+shown.  With 0 you see only where it lands, and a bolt from a wand is
+shown whole, all at once.
+.IP "framerate [30]"
+How many times a second the screen is brought up to date while the
+game is busy with keys you typed ahead or with a run.  Otherwise it is
+drawn once, when the game waits for you, however much changed on the
+way.  With 0 every change is shown as it is made.
 .IP "step [nostep]
 When step is set, lists of things, like inventories or "*" responses to
 "Which item do you wish to xxxx? " questions, are displayed one item
@@ -401,6 +418,39 @@ The default file name for saving the game.  If your phone is hung up by
 accident, rogue will automatically save the game in this file.  The
 file name may contain the special character "~" which expands to be
 your home directory.
+.IP "record []"
+If set, a new game is recorded in this file as it is played: the
+dungeon, your options and every key you type.  The recording can be
+played back with "rogue \-\-replay file".
+.IP "ttyrec []"
+If set, everything sent to your screen is recorded in this file, in
+ttyrec format, for watching later.
+.IP "ttymax [0]"
+The most a ttyrec file may hold, in kilobytes.  When it is full it is
+renamed to file.1 (and file.1 to file.2 and so on, keeping four) and a
+new one is started.  With 0 there is no limit.
+.IP "screen [curses]"
+How the screen is drawn.  "curses" is the usual way.  "ansi" sends
+only what changed, as ANSI escapes and in as few bytes as it can, for
+terminals that understand them and for playing over slow connections.
+"record" draws nothing but writes every screen to the frames file as
+text, and "null" draws nothing at all; both are for playing with keys
+from a file or a pipe.
+.IP "frames []"
+The file "screen=record" writes to.
+.IP "events []"
+If set, the things that happen in the game are written to this file,
+one line for each, with the turn it happened on: entering a level,
+killing a monster, being hit, picking something up, drinking a potion,
+reading a scroll, and how the game ended.  With "screen=ansi" there is
+also a line each time the game gives up the screen, giving how many
+bytes were sent, how many that is a turn and the most sent in one turn.
+.IP "results []"
+If set, a line describing the game is added to this file when it ends:
+the dungeon number, how it ended, turns, depth, gold, your final
+statistics and what you had on.
+It is for running many games and is read with
+.I "rogue \-\-results" .
 .NH
 Acknowledgements
 .PP
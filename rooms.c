@@ -81,7 +81,7 @@ do_rooms()
 	    rp->r_goldval = GOLDCALC;
 	    rnd_pos(rp, &rp->r_gold);
 	    if (roomin(&rp->r_gold) != rp)
-		endwin(), abort();
+		scr_close(), abort();
 	}
 	draw_room(rp);
 	/*
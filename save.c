@@ -20,9 +20,62 @@
 typedef struct stat STAT;
 
 extern char version[], encstr[];
+extern int rs_encode_stat(char *, int, STAT *);
 
 STAT sbuf;
 
+static int ck_pid = 0;			/* Checkpoint being written */
+static bool ck_written = FALSE;		/* Left a checkpoint behind */
+
+/*
+ * The game as auto_save() will write it.  There are two images so one
+ * can be rebuilt while the other stays whole; snap_cur is the whole one.
+ * Each keeps the game unencrypted as well, so rebuilding it only has to
+ * encrypt the blocks that changed.
+ */
+#define S_BLOCK	64			/* Bytes looked at a time */
+
+static char *snap[2], *snap_plain[2];
+static unsigned int snap_len[2], snap_max[2], snap_plen[2];
+static char snap_name[2][80], snap_tmp[2][90], snap_delta[2][90];
+static volatile sig_atomic_t snap_cur = -1;
+
+/*
+ * Delta checkpoints.  Between full checkpoints only the parts of the
+ * image that changed since the last full one are written, to the save
+ * file's name with ".d" on the end.  Each delta is against the full
+ * image, so a new one replaces the old and restoring needs at most one.
+ * The stat record on the end of the image is never in a delta; it
+ * stays the one in the save file.
+ */
+#define D_MAGIC	"R36d"
+#define D_HEAD	20		/* magic, base size and sum, size, runs */
+#define D_GAP	8		/* Unchanged bytes worth running across */
+#define D_FULL	32		/* Deltas between full checkpoints */
+
+static char *base_img, *dbuf;
+static unsigned int base_len = 0, base_max = 0, dbuf_len, dbuf_max = 0;
+static unsigned long base_sum;
+static int ck_deltas = 0;
+
+/*
+ * Where encwrite() puts things when it isn't given a file
+ */
+static char *enc_buf;
+static unsigned int enc_len, enc_max;
+
+static void ckpt_wait();
+static int write_image();
+static int make_delta();
+static int write_delta();
+static bool apply_delta();
+static void delta_head();
+static unsigned long img_sum();
+static void put_header();
+static void enc_at();
+static int write_all();
+static void list_some();
+
 int
 save_game()
 {
@@ -61,6 +114,8 @@ save_game()
 	}
 	strcpy(file_name, buf);
 gotfile:
+	rec_close();
+	ckpt_wait();
 	if ((savef = fopen(file_name, "w")) == NULL)
 	    msg(strerror(errno));	/* fake perror() */
     } while (savef == NULL);
@@ -70,26 +125,180 @@ gotfile:
      * The fwrite is to force allocation of the buffer before the write
      */
     save_file(savef);
+    sprintf(buf, "%.77s.d", file_name);
+    md_unlink(buf);
+    base_len = 0;
     return TRUE;
 }
 
 /*
  * automatically save a file.  This is used if a HUP signal is
- * recieved
+ * recieved.  We are in a signal handler, so all we do is put out the
+ * image snapshot() made at the end of the last turn.
  */
 void
 auto_save(signum)
 int signum;
 {
-    register FILE *savef;
-    register int i;
+    register int i, n;
 
     for (i = 0; i < NSIG; i++)
 	signal(i, SIG_IGN);
-    if (file_name[0] != '\0' && (savef = fopen(file_name, "w")) != NULL)
-	save_file(savef);
-    endwin();
-    exit(1);
+    if (ck_pid > 0)
+	md_killchild(ck_pid);
+    if ((n = snap_cur) >= 0)
+	write_image(n);
+    /*
+     * Nothing here can go through curses or stdio, so only the modes
+     * go back; after a hangup there is no terminal left for them
+     */
+    if (signum != SIGHUP)
+	md_ttyreset();
+    _exit(1);
+}
+
+/*
+ * snapshot:
+ *	Serialize the game into memory for auto_save().  Called at the
+ *	end of every turn.  If nothing changed since the last one, that
+ *	one will do.  The stat record is left empty, as write_image()
+ *	puts in the one for the file it writes.
+ */
+void
+snapshot()
+{
+    register int n;
+    register unsigned int i, m, head, size;
+    register char *img;
+    size_t len;
+
+    if (file_name[0] == '\0' || headless)
+	return;
+    if ((img = rs_frame(&len)) == NULL || len == 0)
+	return;
+    if ((n = snap_cur) >= 0 && snap_plen[n] == len
+	&& strcmp(snap_name[n], file_name) == 0
+	&& memcmp(snap_plain[n], img, len) == 0)
+	return;
+    n = (n == 0);
+    size = 5 * 80 + len + RS_STAT_SIZE;
+    if (size > snap_max[n])
+    {
+	/*
+	 * Make room (and some to spare)
+	 */
+	free(snap[n]);
+	free(snap_plain[n]);
+	snap_max[n] = snap_plen[n] = 0;
+	if ((snap[n] = malloc(size + size / 4)) == NULL
+	    || (snap_plain[n] = malloc(size + size / 4)) == NULL)
+	    return;
+	snap_max[n] = size + size / 4;
+    }
+    enc_buf = snap[n];
+    enc_max = snap_max[n];
+    enc_len = 0;
+    put_header(NULL);
+    head = enc_len;
+    for (i = 0; i < len; i += m)
+    {
+	m = (len - i < S_BLOCK) ? len - i : S_BLOCK;
+	if (i + m <= snap_plen[n] && memcmp(&snap_plain[n][i], &img[i], m) == 0)
+	    continue;
+	memcpy(&snap_plain[n][i], &img[i], m);
+	enc_at(&snap[n][head + i], &img[i], m, i);
+    }
+    snap_plen[n] = len;
+    memset(&snap[n][head + len], 0, RS_STAT_SIZE);
+    snap_len[n] = head + len + RS_STAT_SIZE;
+    strcpy(snap_name[n], file_name);
+    sprintf(snap_tmp[n], "%s.tmp", file_name);
+    sprintf(snap_delta[n], "%s.d", file_name);
+    snap_cur = n;
+}
+
+/*
+ * enc_at:
+ *	Encrypt bytes as encwrite() would if they were off bytes into
+ *	what it was given
+ */
+static void
+enc_at(to, from, size, off)
+register char *to, *from;
+register unsigned int size;
+unsigned int off;
+{
+    static unsigned int klen = 0;
+    register char *ep;
+
+    if (klen == 0)
+	klen = strlen(encstr);
+    ep = &encstr[off % klen];
+    while (size--)
+    {
+	*to++ = *from++ ^ *ep++;
+	if (*ep == '\0')
+	    ep = encstr;
+    }
+}
+
+/*
+ * write_image:
+ *	Put a snapshot out as the save file, by way of a scratch file so
+ *	dying in the middle never leaves half a game behind.  Only uses
+ *	calls that are safe from a signal handler.
+ */
+static int
+write_image(n)
+register int n;
+{
+    register int fd, len;
+    char stat_rec[64];
+
+    if ((fd = open(snap_tmp[n], O_WRONLY|O_CREAT|O_TRUNC, 0666)) < 0)
+	return FALSE;
+    /*
+     * The stat record on the end has to be the one for this file
+     */
+    fstat(fd, &sbuf);
+    len = rs_encode_stat(stat_rec, sizeof stat_rec, &sbuf);
+    enccrypt(stat_rec, len);
+    if (!write_all(fd, snap[n], snap_len[n] - len)
+	|| !write_all(fd, stat_rec, len)
+	|| close(fd) != 0
+	|| rename(snap_tmp[n], snap_name[n]) != 0)
+    {
+	unlink(snap_tmp[n]);
+	return FALSE;
+    }
+    unlink(snap_delta[n]);		/* it was against the old one */
+    return TRUE;
+}
+
+/*
+ * write_all:
+ *	write() all of a buffer, or say why not
+ */
+static int
+write_all(fd, buf, len)
+int fd;
+register char *buf;
+register unsigned int len;
+{
+    register int n;
+
+    while (len > 0)
+    {
+	if ((n = write(fd, buf, len)) < 0)
+	{
+	    if (errno == EINTR)
+		continue;
+	    return FALSE;
+	}
+	buf += n;
+	len -= n;
+    }
+    return TRUE;
 }
 
 /*
@@ -99,30 +308,426 @@ int
 save_file(savef)
 register FILE *savef;
 {
-    char buf[80];
-    int ret;
-    
     wmove(cw, LINES-1, 0);
     draw(cw);
+    return write_save(savef);
+}
+
+/*
+ * write_save:
+ *	Put the game out on savef and close it.  This never touches the
+ *	screen, so it is safe to use from a checkpoint process.
+ */
+int
+write_save(savef)
+register FILE *savef;
+{
+    int ret;
+
     fstat(fileno(savef), &sbuf);
     fwrite("junk", 1, 5, savef);
     fseek(savef, 0L, 0);
 
+    put_header(savef);
+    ret = rs_save_file(savef);
+
+    if (fclose(savef) == EOF && ret == 0)
+	ret = errno;
+
+    return(ret);
+}
+
+/*
+ * put_header:
+ *	The lines at the front of a save file that restore() checks,
+ *	then who it is and how far he got, which is all list_saves()
+ *	reads.
+ */
+static void
+put_header(savef)
+register FILE *savef;
+{
+    char buf[80];
+
     memset(buf,0,80);
     strcpy(buf,version);
     encwrite(buf,80,savef);
     memset(buf,0,80);
-    strcpy(buf,"R36 2\n");
+    sprintf(buf,"R36 %d\n", RS_FORMAT);
     encwrite(buf,80,savef);
     memset(buf,0,80);
     sprintf(buf,"%d x %d\n", LINES, COLS);
     encwrite(buf,80,savef);
-    
-    ret = rs_save_file(savef);
+    memset(buf,0,80);
+    strcpy(buf,whoami);
+    encwrite(buf,80,savef);
+    memset(buf,0,80);
+    sprintf(buf,"%d %d %d %d %ld\n", level, purse, turns, dnum, (long) time(NULL));
+    encwrite(buf,80,savef);
+}
+
+/*
+ * checkpoint:
+ *	Called at the end of every turn, after snapshot().  If autosave
+ *	is set, write the game out every autosave turns and whenever he
+ *	changes level: usually just a delta, but all of it when there is
+ *	no full image yet, every D_FULL deltas, or when the delta would
+ *	be more than a quarter of the whole.  The writing is done by a
+ *	child working on a copy-on-write image of the game, so the player
+ *	never waits on the disk.
+ */
+void
+checkpoint()
+{
+    static int since = 0, ck_level = 0;
+    register int n;
+    register bool full;
+    char *buf;
 
-    fclose(savef);
+    if (autosave <= 0 || file_name[0] == '\0')
+	return;
+    if (ck_pid > 0 && md_waitpid(ck_pid, TRUE) != 0)
+	ck_pid = 0;
+    if (++since < autosave && level == ck_level)
+	return;
+    /*
+     * If the last one hasn't finished yet, try again next turn
+     */
+    if (ck_pid > 0 || (n = snap_cur) < 0)
+	return;
+    since = 0;
+    ck_level = level;
+    full = (base_len == 0 || strcmp(snap_name[n], file_name) != 0
+	|| ++ck_deltas > D_FULL || !make_delta(n));
+    if (full)
+    {
+	/*
+	 * This is the new base for deltas
+	 */
+	ck_deltas = 0;
+	base_len = 0;
+	if (snap_len[n] > base_max && (buf = malloc(snap_len[n])) != NULL)
+	{
+	    free(base_img);
+	    base_img = buf;
+	    base_max = snap_len[n];
+	}
+	if (snap_len[n] <= base_max)
+	{
+	    memcpy(base_img, snap[n], snap_len[n]);
+	    base_len = snap_len[n];
+	    base_sum = img_sum(base_img, base_len - RS_STAT_SIZE);
+	}
+    }
+    ck_written = TRUE;
+    if ((ck_pid = md_fork()) == 0)
+    {
+	md_ignoreallsignals();
+	_exit((full ? write_image(n) : write_delta(n)) ? 0 : 1);
+    }
+    if (ck_pid < 0)
+    {
+	ck_pid = 0;
+	if (full)
+	    write_image(n);
+	else
+	    write_delta(n);
+    }
+}
 
-    return(ret);
+/*
+ * put_long:
+ *	Four bytes, low first, for delta files
+ */
+static void
+put_long(cp, l)
+register unsigned char *cp;
+register unsigned long l;
+{
+    cp[0] = l & 0xff;
+    cp[1] = (l >> 8) & 0xff;
+    cp[2] = (l >> 16) & 0xff;
+    cp[3] = (l >> 24) & 0xff;
+}
+
+static unsigned long
+get_long(cp)
+register unsigned char *cp;
+{
+    return cp[0] | (cp[1] << 8) | ((unsigned long) cp[2] << 16)
+	| ((unsigned long) cp[3] << 24);
+}
+
+/*
+ * img_sum:
+ *	Check sum of an image, so a delta is only ever put on the image
+ *	it was made from
+ */
+static unsigned long
+img_sum(cp, len)
+register char *cp;
+register unsigned int len;
+{
+    register unsigned long h = 2166136261UL;
+
+    while (len--)
+	h = ((h ^ (unsigned char) *cp++) * 16777619UL) & 0xffffffffUL;
+    return h;
+}
+
+/*
+ * make_delta:
+ *	Build the delta from the base to snapshot n.  Returns FALSE if
+ *	it would be too big to be worth it.
+ */
+static int
+make_delta(n)
+int n;
+{
+    register char *img = snap[n];
+    register unsigned int i, j, end, same;
+    unsigned int len, blen, limit, nruns;
+    char *buf;
+
+    len = snap_len[n] - RS_STAT_SIZE;
+    blen = base_len - RS_STAT_SIZE;
+    limit = len / 4;
+    if (dbuf_max < limit + D_HEAD)
+    {
+	if ((buf = malloc(limit + D_HEAD)) == NULL)
+	    return FALSE;
+	free(dbuf);
+	dbuf = buf;
+	dbuf_max = limit + D_HEAD;
+    }
+    nruns = 0;
+    dbuf_len = D_HEAD;
+    for (i = 0; i < len; i = end)
+    {
+	if (i < blen && img[i] == base_img[i])
+	{
+	    end = i + 1;
+	    continue;
+	}
+	/*
+	 * A run goes on until D_GAP bytes in a row are the same
+	 */
+	end = i + 1;
+	same = 0;
+	for (j = end; j < len && same < D_GAP; j++)
+	    if (j < blen && img[j] == base_img[j])
+		same++;
+	    else
+	    {
+		same = 0;
+		end = j + 1;
+	    }
+	if (dbuf_len + 8 + (end - i) > limit)
+	    return FALSE;
+	put_long((unsigned char *) dbuf + dbuf_len, i);
+	put_long((unsigned char *) dbuf + dbuf_len + 4, end - i);
+	memcpy(dbuf + dbuf_len + 8, img + i, end - i);
+	dbuf_len += 8 + (end - i);
+	nruns++;
+    }
+    memcpy(dbuf, D_MAGIC, 4);
+    put_long((unsigned char *) dbuf + 4, blen);
+    put_long((unsigned char *) dbuf + 8, base_sum);
+    put_long((unsigned char *) dbuf + 12, len);
+    put_long((unsigned char *) dbuf + 16, nruns);
+    return TRUE;
+}
+
+/*
+ * write_delta:
+ *	Put out the delta made by make_delta()
+ */
+static int
+write_delta(n)
+int n;
+{
+    register FILE *df;
+    char tmp[100];
+    int ok;
+
+    sprintf(tmp, "%s.tmp", snap_delta[n]);
+    if ((df = fopen(tmp, "w")) == NULL)
+	return FALSE;
+    ok = (fwrite(dbuf, 1, dbuf_len, df) == dbuf_len);
+    if (fclose(df) == EOF || !ok || md_rename(tmp, snap_delta[n]) != 0)
+    {
+	md_unlink(tmp);
+	return FALSE;
+    }
+    return TRUE;
+}
+
+/*
+ * apply_delta:
+ *	If there is a delta for this save file made from this image,
+ *	put it on.  Anything wrong with it and the image is left alone.
+ */
+static bool
+apply_delta(dname, imgp, lenp)
+char *dname;
+char **imgp;
+unsigned int *lenp;
+{
+    register FILE *df;
+    register unsigned int i;
+    unsigned char head[D_HEAD], run[8];
+    unsigned long blen, len, nruns, off, rlen;
+    char *img;
+
+    if ((df = fopen(dname, "r")) == NULL)
+	return FALSE;
+    img = NULL;
+    if (fread(head, 1, D_HEAD, df) != D_HEAD || memcmp(head, D_MAGIC, 4) != 0)
+	goto bad;
+    blen = get_long(head + 4);
+    len = get_long(head + 12);
+    nruns = get_long(head + 16);
+    if (blen + RS_STAT_SIZE != *lenp || get_long(head + 8) != img_sum(*imgp, blen))
+	goto bad;
+    if ((img = malloc(len + RS_STAT_SIZE)) == NULL)
+	goto bad;
+    memcpy(img, *imgp, (len < blen) ? len : blen);
+    for (i = 0; i < nruns; i++)
+    {
+	if (fread(run, 1, 8, df) != 8)
+	    goto bad;
+	off = get_long(run);
+	rlen = get_long(run + 4);
+	if (off > len || rlen > len - off || fread(img + off, 1, rlen, df) != rlen)
+	    goto bad;
+    }
+    fclose(df);
+    memcpy(img + len, *imgp + blen, RS_STAT_SIZE);
+    free(*imgp);
+    *imgp = img;
+    *lenp = len + RS_STAT_SIZE;
+    return TRUE;
+bad:
+    fclose(df);
+    free(img);
+    return FALSE;
+}
+
+/*
+ * drop_checkpoint:
+ *	The game is over, so don't leave anything around to restore,
+ *	and don't let a late signal write one either.
+ */
+void
+drop_checkpoint()
+{
+    char dname[90];
+
+    ckpt_wait();
+    if (ck_written)
+    {
+	md_unlink(file_name);
+	sprintf(dname, "%s.d", file_name);
+	md_unlink(dname);
+    }
+    ck_written = FALSE;
+    snap_cur = -1;
+}
+
+/*
+ * ckpt_wait:
+ *	Let a checkpoint that is still being written finish, so it can't
+ *	land on top of a newer save.
+ */
+static void
+ckpt_wait()
+{
+    if (ck_pid > 0)
+	md_waitpid(ck_pid, FALSE);
+    ck_pid = 0;
+}
+
+/*
+ * delta_head:
+ *	Put just the part of a delta that falls in the first size bytes
+ *	on to buf, so list_saves() shows where the game really is
+ */
+static void
+delta_head(dname, buf, size)
+char *dname, *buf;
+unsigned int size;
+{
+    register FILE *df;
+    register unsigned long i, nruns, off, rlen;
+    unsigned char head[D_HEAD], run[8];
+
+    if ((df = fopen(dname, "r")) == NULL)
+	return;
+    if (fread(head, 1, D_HEAD, df) == D_HEAD && memcmp(head, D_MAGIC, 4) == 0)
+    {
+	nruns = get_long(head + 16);
+	for (i = 0; i < nruns && fread(run, 1, 8, df) == 8; i++)
+	{
+	    off = get_long(run);
+	    rlen = get_long(run + 4);
+	    if (off >= size)
+		break;
+	    if (fread(buf + off, 1, (rlen < size - off) ? rlen : size - off, df) == 0
+		|| (rlen > size - off && fseek(df, rlen - (size - off), SEEK_CUR) != 0))
+		break;
+	}
+    }
+    fclose(df);
+}
+
+/*
+ * read_image:
+ *	Read all of a save file into memory
+ */
+static char *
+read_image(fd, lenp)
+int fd;
+unsigned int *lenp;
+{
+    register char *img, *buf;
+    register int n;
+    unsigned int len, max;
+
+    len = 0;
+    max = 8192;
+    if ((img = malloc(max)) == NULL)
+	return NULL;
+    while ((n = read(fd, img + len, max - len)) > 0)
+	if ((len += n) == max)
+	{
+	    if ((buf = realloc(img, max * 2)) == NULL)
+	    {
+		free(img);
+		return NULL;
+	    }
+	    img = buf;
+	    max *= 2;
+	}
+    *lenp = len;
+    return img;
+}
+
+/*
+ * get_line:
+ *	Take the next of the 80 byte header lines off the front of an image
+ */
+static bool
+get_line(buf, img, posp, len)
+char *buf, *img;
+unsigned int *posp, len;
+{
+    if (len - *posp < 80)
+	return FALSE;
+    memcpy(buf, img + *posp, 80);
+    enccrypt(buf, 80);
+    buf[79] = '\0';
+    *posp += 80;
+    return TRUE;
 }
 
 int
@@ -131,11 +736,13 @@ register char *file;
 char **envp;
 {
     register int inf;
-    char buf[80];
+    char buf[80], dname[90];
     int slines, scols;
     int rogue_version = 0, savefile_version = 0;
     STAT sbuf2;
-    FILE *savef;
+    char *img;
+    unsigned int len, pos;
+    bool patched;
 
     if (strcmp(file, "-r") == 0)
 	file = file_name;
@@ -144,49 +751,69 @@ char **envp;
 	perror(file);
 	return FALSE;
     }
+    fstat(inf, &sbuf2);
+    if ((img = read_image(inf, &len)) == NULL)
+    {
+	perror(file);
+	return FALSE;
+    }
+
+    /*
+     * A checkpoint may have left a delta on top of the file
+     */
+    sprintf(dname, "%.77s.d", file);
+    patched = apply_delta(dname, &img, &len);
 
     fflush(stdout);
-    encread(buf, 80, inf);
-    if (strcmp(buf, version) != 0)
+    pos = 0;
+    if (!get_line(buf, img, &pos, len) || strcmp(buf, version) != 0)
     {
 	printf("Sorry, saved game is out of date.\n");
 	return FALSE;
     }
 
-    fstat(inf, &sbuf2);
-    fflush(stdout);
-
-    encread(buf, 80, inf);
+    get_line(buf, img, &pos, len);
     sscanf(buf, "R%d %d\n", &rogue_version, &savefile_version);
 
-    if ((rogue_version != 36) && (savefile_version != 2))
+    if ((rogue_version != 36) || (savefile_version < 3)
+	|| (savefile_version > RS_FORMAT))
     {
 	printf("Sorry, saved game format is out of date.\n");
 	return FALSE;
     }
 
-    encread(buf,80,inf);
+    get_line(buf, img, &pos, len);
     sscanf(buf,"%d x %d\n",&slines, &scols);
 
-    initscr();  
+    if (savefile_version >= 5)		/* skip the list_saves() lines */
+    {
+	get_line(buf, img, &pos, len);
+	get_line(buf, img, &pos, len);
+    }
+
+    if (!scr_open())
+    {
+	printf("Cannot start the %s screen\n", display->b_name);
+	return(FALSE);
+    }
     cw = newwin(LINES, COLS, 0, 0);
     mw = newwin(LINES, COLS, 0, 0);
     hw = newwin(LINES, COLS, 0, 0);
     nocrmode();    
     keypad(cw,1);
 
-    savef = fdopen(inf,"r");
-
-    if (rs_restore_file(savef) != 0)
+    if (pos > len || rs_restore_image(img + pos, len - pos, savefile_version) != 0)
     {
-	endwin();
+	scr_close();
 	printf("Cannot restore file\n");
     	return(FALSE);
     }
+    pack_index();
+    newnames();
 	
     if (slines > LINES)
     {
-	endwin();
+	scr_close();
     	printf("Sorry, original game was played on a screen with %d lines.\n",slines);
 		printf("Current screen only has %d lines. Unable to restore game\n",LINES);
 		return(FALSE);
@@ -194,7 +821,7 @@ char **envp;
 	
     if (scols > COLS)
     {
-	endwin();
+	scr_close();
     	printf("Sorry, original game was played on a screen with %d columns.\n",scols);
 		printf("Current screen only has %d columns. Unable to restore game\n",COLS);
 		return(FALSE);
@@ -209,13 +836,13 @@ char **envp;
     {
 	if (sbuf2.st_ino != sbuf.st_ino || sbuf2.st_dev != sbuf.st_dev)
 	{
-	    endwin();
+	    scr_close();
 	    printf("Sorry, saved game is not in the same file.\n");
 	    return FALSE;
 	}
 	else if (sbuf2.st_ctime - sbuf.st_ctime > 15)
 	{
-	    endwin();
+	    scr_close();
 	    printf("Sorry, file has been touched.\n");
 	    return FALSE;
 	}
@@ -230,20 +857,24 @@ char **envp;
     {
 	if (sbuf2.st_nlink != 1)
 	{
-	    endwin();
+	    scr_close();
 	    printf("Cannot restore from a linked file\n");
 	    return FALSE;
 	}
 	else if (md_unlink_open_file(file, inf) < 0)
 	{
-	    endwin();
+	    scr_close();
 	    printf("Cannot unlink file\n");
 	    return FALSE;
 	}
+	if (patched)
+	    md_unlink(dname);
     }
+    free(img);
     environ = envp;
     strcpy(file_name, file);
     setup();
+    ev_open();
     clearok(curscr, TRUE);
     touchwin(cw);
     srand(getpid());
@@ -254,7 +885,97 @@ char **envp;
 }
 
 /*
- * perform an encrypted write
+ * list_saves:
+ *	Put out a line for each saved game in dir, for a front end to
+ *	show: file, name, level, gold, turns, dungeon, time and format.
+ *	Only the lines at the front of each file are read.  A big
+ *	directory is split between a few processes.
+ */
+#define NLIST	4
+
+void
+list_saves(dir)
+char *dir;
+{
+    register char **names;
+    register int n, i;
+    int pid[NLIST];
+
+    if ((names = md_listdir(dir)) == NULL)
+    {
+	perror(dir);
+	exit(1);
+    }
+    for (n = 0; names[n] != NULL; n++)
+	continue;
+    fflush(stdout);
+    for (i = 1; i < NLIST; i++)
+    {
+	pid[i] = (n >= 64 * NLIST) ? md_fork() : -1;
+	if (pid[i] == 0)
+	{
+	    list_some(dir, names, n, i, NLIST);
+	    _exit(0);
+	}
+	if (pid[i] < 0)
+	    list_some(dir, names, n, i, NLIST);
+    }
+    list_some(dir, names, n, 0, NLIST);
+    for (i = 1; i < NLIST; i++)
+	if (pid[i] > 0)
+	    md_waitpid(pid[i], FALSE);
+}
+
+/*
+ * list_some:
+ *	Do every step'th file, starting at start.  Each line goes out
+ *	in one write() so they don't get mixed up with the others.
+ */
+static void
+list_some(dir, names, n, start, step)
+char *dir;
+char **names;
+int n, start, step;
+{
+    register int i, fd;
+    char head[5][80], path[1024], line[1024 + 200];
+    int vers, lev, gold, nturns, dn;
+    long date;
+
+    for (i = start; i < n; i += step)
+    {
+	sprintf(path, "%.500s/%.500s", dir, names[i]);
+	if ((fd = open(path, O_RDONLY)) < 0)
+	    continue;
+	if (read(fd, head, sizeof head) != sizeof head)
+	{
+	    close(fd);
+	    continue;
+	}
+	close(fd);
+	if (snprintf(line, sizeof line, "%s.d", path) >= (int) sizeof line)
+	    continue;
+	delta_head(line, head[0], sizeof head);
+	enccrypt(head[0], 80);
+	enccrypt(head[1], 80);
+	head[0][79] = head[1][79] = '\0';
+	if (strcmp(head[0], version) != 0
+	    || sscanf(head[1], "R36 %d", &vers) != 1 || vers < 5)
+	    continue;
+	enccrypt(head[3], 80);
+	enccrypt(head[4], 80);
+	head[3][79] = head[4][79] = '\0';
+	if (sscanf(head[4], "%d %d %d %d %ld", &lev, &gold, &nturns, &dn, &date) != 5)
+	    continue;
+	snprintf(line, sizeof line, "%s\t%s\t%d\t%d\t%d\t%d\t%ld\t%d\n",
+	    path, head[3], lev, gold, nturns, dn, date, vers);
+	write(1, line, strlen(line));
+    }
+}
+
+/*
+ * perform an encrypted write.  With no file it goes into enc_buf,
+ * and enc_len counts what would not fit as well.
  */
 int
 encwrite(start, size, outf)
@@ -263,12 +984,17 @@ unsigned int size;
 register FILE *outf;
 {
     register char *ep;
+    register int c;
 
     ep = encstr;
 
     while (size--)
     {
-	putc(*start++ ^ *ep++, outf);
+	c = *start++ ^ *ep++;
+	if (outf != NULL)
+	    putc(c, outf);
+	else if (enc_len++ < enc_max)
+	    enc_buf[enc_len - 1] = c;
 	if (*ep == '\0')
 	    ep = encstr;
     }
@@ -283,12 +1009,25 @@ register char *start;
 unsigned int size;
 register int inf;
 {
-    register char *ep;
     register int read_size;
 
     if ((read_size = read(inf, start, size)) == -1 || read_size == 0)
 	return read_size;
 
+    enccrypt(start, size);
+    return read_size;
+}
+
+/*
+ * encrypt or decrypt a buffer in place
+ */
+void
+enccrypt(start, size)
+register char *start;
+unsigned int size;
+{
+    register char *ep;
+
     ep = encstr;
 
     while (size--)
@@ -297,5 +1036,4 @@ register int inf;
 	if (*ep == '\0')
 	    ep = encstr;
     }
-    return read_size;
 }
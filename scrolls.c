@@ -40,6 +40,7 @@ read_scroll()
      */
     if (obj == cur_weapon)
 	cur_weapon = NULL;
+    event("read", "\"scroll\":\"%s\"", s_magic[obj->o_which].mi_name);
     switch(obj->o_which)
     {
 	case S_CONFUSE:
@@ -296,6 +297,7 @@ read_scroll()
 	    strcpy(s_guess[obj->o_which], buf);
 	}
     }
+    newnames();
     /*
      * Get rid of the thing
      */
@@ -304,7 +306,7 @@ read_scroll()
 	obj->o_count--;
     else
     {
-	detach(pack, item);
+	del_pack(item);
         discard(item);
     }
 }
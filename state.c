@@ -16,6 +16,7 @@
     OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 */
 
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <curses.h>
@@ -54,6 +55,61 @@
 #define RSID_ROOMS        0XABCD0017
 #define RSID_STAT         0xABCD0018
 
+/*
+    Lists that saved pointers refer into.  The numbers are the listids
+    written for t_dest, so they can't change.
+*/
+
+#define RS_LIST_MONSTERS  1
+#define RS_LIST_OBJECTS   2
+#define RS_LIST_GOLD      3
+#define RS_LIST_PACK      4
+#define RS_NLISTS         5
+
+/*
+    Field tables.  Each one lists, in file order, what is saved of a
+    structure or of the global game state.  rs_write_fields() and
+    rs_read_fields() are the only code that walks them, so reading and
+    writing can't get out of step.  Fields added to the format later go
+    after an RS_SINCE entry, and are left alone when reading older files.
+*/
+
+#define RS_END     0
+#define RS_MARKER  1            /* count is the marker id               */
+#define RS_LENGTH  2            /* count is how many of the next entry  */
+#define RS_SINCE   3            /* count is the format the rest began in */
+#define RS_INT     4
+#define RS_SHORT   5
+#define RS_LONG    6
+#define RS_BOOL    7
+#define RS_CHAR    8
+#define RS_CHARS   9            /* size bytes, after their length       */
+#define RS_STRUCT 10            /* laid out by sub                      */
+#define RS_FUNC   11            /* written by wfunc, read by rfunc      */
+
+struct rs_field
+{
+    int type;
+    size_t offset;                      /* Where it is in the structure */
+    void *addr;                         /* Where it is, for globals */
+    int count;                          /* How many of them */
+    size_t size;                        /* Size of each one */
+    const struct rs_field *sub;         /* Layout of an RS_STRUCT */
+    void (*wfunc)(FILE *savef, void *p);
+    void (*rfunc)(FILE *savef, void *p);
+};
+
+#define RS_MEMBER(type, s, f, n, sub) \
+    { type, offsetof(s, f), NULL, n, sizeof(((s *) 0)->f) / (n), sub, NULL, NULL }
+#define RS_GLOBAL(type, v, n, sub) \
+    { type, 0, (void *) &(v), n, sizeof(v) / (n), sub, NULL, NULL }
+#define RS_MEMBERCALL(s, f, w, r) \
+    { RS_FUNC, offsetof(s, f), NULL, 1, 0, NULL, w, r }
+#define RS_CALL(v, w, r) \
+    { RS_FUNC, 0, (void *) (v), 1, 0, NULL, w, r }
+#define RS_TAG(type, n) \
+    { type, 0, NULL, n, 0, NULL, NULL, NULL }
+
 #define READSTAT (format_error || read_error )
 #define WRITESTAT (write_error)
 
@@ -78,17 +134,16 @@ void rs_read_string(FILE *savef, char *s, int max);
 void rs_read_new_string(FILE *savef, char **s);
 void rs_write_string_index(FILE *savef, char master[][15], int max, char *str);
 void rs_read_string_index(FILE *savef,  char master[][15], int maxindex, char **str);
-void rs_write_coord(FILE *savef, coord c);
-void rs_read_coord(FILE *savef, coord *c);
-void rs_write_str_t(FILE *savef, str_t str);
-void rs_read_str_t(FILE *savef, str_t *str);
 void rs_write_window(FILE *savef, WINDOW *win);
 void rs_read_window(FILE *savef, WINDOW *win);
-void *get_list_item(struct linked_list *l, int i);
-int find_list_ptr(struct linked_list *l, void *ptr);
+void rs_index_clear(void);
+void rs_index_add(int listid, void *ptr);
+void rs_index_list(int listid, struct linked_list *l);
+void rs_index_things(struct linked_list *l);
+void rs_index_objects(struct linked_list *l);
+int rs_index_find(int listid, void *ptr);
+void *rs_index_item(int listid, int i);
 int list_size(struct linked_list *l);
-void rs_write_stats(FILE *savef, struct stats *s);
-void rs_read_stats(FILE *savef, struct stats *s);
 void rs_write_scrolls(FILE *savef);
 void rs_read_scrolls(FILE *savef);
 void rs_write_potions(FILE *savef);
@@ -99,21 +154,16 @@ void rs_write_sticks(FILE *savef);
 void rs_read_sticks(FILE *savef);
 void rs_write_daemons(FILE *savef, struct delayed_action *dlist, int cnt);
 void rs_read_daemons(FILE *savef, struct delayed_action *dlist, int cnt);
-void rs_write_room(FILE *savef, struct room *r);
-void rs_read_room(FILE *savef, struct room *r);
-void rs_write_rooms(FILE *savef, struct room r[], int cnt);
-void rs_read_rooms(FILE *savef, struct room *r, int cnt);
 void rs_write_room_reference(FILE *savef, struct room *rp);
 void rs_read_room_reference(FILE *savef, struct room **rp);
-void rs_write_object(FILE *savef, struct object *o);
-void rs_read_object(FILE *savef, struct object *o);
 void rs_write_object_list(FILE *savef, struct linked_list *l);
 void rs_read_object_list(FILE *savef, struct linked_list **list);
-void rs_write_object_reference(FILE *savef, struct linked_list *list, struct object *item);
-void rs_read_object_reference(FILE *savef, struct linked_list *list, struct object **item);
-int find_room_coord(const struct room *rmlist, const coord *c, int n);
-int find_thing_coord(struct linked_list *monlist, coord *c);
-int find_object_coord(struct linked_list *objlist, coord *c);
+void rs_write_object_reference(FILE *savef, int listid, struct object *item);
+void rs_read_object_reference(FILE *savef, int listid, struct object **item);
+void rs_write_dest(FILE *savef, void *p);
+void rs_read_dest(FILE *savef, void *p);
+void rs_write_pack(FILE *savef, void *p);
+void rs_read_pack(FILE *savef, void *p);
 void rs_write_thing(FILE *savef, struct thing *t);
 void rs_read_thing(FILE *savef, struct thing *t);
 void rs_fix_thing(struct thing *t);
@@ -122,12 +172,11 @@ void rs_read_thing_list(FILE *savef, struct linked_list **list);
 void rs_fix_thing_list(struct linked_list *list);
 void rs_fix_magic_items(struct magic_item *mi, int cnt);
 void rs_fix_monsters(struct monster mons[26]);
-void rs_write_trap(FILE *savef, struct trap *trap);
-void rs_read_trap(FILE *savef, struct trap *trap);
-void rs_write_traps(FILE *savef, struct trap t[], int cnt);
-void rs_read_traps(FILE *savef, struct trap *t, int cnt);
 void rs_read_stat(FILE *savef, struct stat *sbuf);
 void rs_write_stat(FILE *saved, struct stat *sbuf);
+int rs_encode_stat(char *buf, int max, struct stat *sbuf);
+void rs_write_fields(FILE *savef, const struct rs_field *f, void *base);
+void rs_read_fields(FILE *savef, const struct rs_field *f, void *base);
 
 static int encerrno = 0;
 
@@ -153,16 +202,73 @@ encclearerr(void)
     return(n);
 }
 
+/*
+    The save file is put together in rs_buf and handed to encwrite() in
+    one piece, and restoring decodes from a copy of the whole file.
+    Format 3 files were encrypted a field at a time, so for those
+    rs_read() decrypts each field as it goes.
+*/
+
+static char *rs_buf = NULL;
+static size_t rs_len = 0, rs_max = 0, rs_pos = 0;
+static int rs_fixed = FALSE;            /* rs_buf was lent to us */
+static int rs_version = RS_FORMAT;      /* Format being read */
+
+static int
+rs_reserve(size_t size)
+{
+    char *buf;
+    size_t n;
+
+    if (rs_len + size <= rs_max)
+        return(0);
+
+    if (rs_fixed)
+    {
+        encseterr(ENOSPC);
+        return(-1);
+    }
+
+    for(n = (rs_max == 0) ? 32768 : rs_max; n < rs_len + size; n *= 2)
+        continue;
+
+    if ((buf = realloc(rs_buf, n)) == NULL)
+    {
+        encseterr(ENOMEM);
+        return(-1);
+    }
+
+    rs_buf = buf;
+    rs_max = n;
+
+    return(0);
+}
+
 void
 rs_write(FILE *savef, void *ptr, size_t size)
 {
-    encwrite(ptr, size, savef);
+    if (rs_reserve(size) != 0)
+        return;
+
+    memcpy(rs_buf + rs_len, ptr, size);
+    rs_len += size;
 }
 
 void
 rs_read(FILE *savef, void *ptr, size_t size)
 {   
-    encread(ptr, size, fileno(savef));
+    if (rs_pos + size > rs_len)
+    {
+        encseterr(EILSEQ);
+        memset(ptr, 0, size);
+        return;
+    }
+
+    memcpy(ptr, rs_buf + rs_pos, size);
+    rs_pos += size;
+
+    if (rs_version < 4)
+        enccrypt(ptr, size);
 }
 
 void
@@ -524,7 +630,10 @@ rs_read_string_index(FILE *savef, char master[][15], int maxindex, char **str)
 
     rs_read_int(savef, &i);
 
-    if (!encerror() && (i > maxindex))
+    if (encerror())
+        return;
+
+    if (i > maxindex)
         encseterr(EILSEQ);
     else if (i >= 0)
         *str = master[i];
@@ -532,65 +641,116 @@ rs_read_string_index(FILE *savef, char master[][15], int maxindex, char **str)
         *str = NULL;
 }
 
-void
-rs_write_coord(FILE *savef, coord c)
-            {
-    rs_write_int(savef, c.x);
-    rs_write_int(savef, c.y);
-            }
+/*
+    The windows are most of a snapshot, and from one turn to the next
+    most of their rows stay the same.  So what each row held, and the
+    bytes it was written as, are kept, and a row that hasn't changed
+    is copied rather than written a character at a time.  A row is
+    known by what is in it, not by which window it came from, so the
+    copy can't go stale.
+*/
 
-void
-rs_read_coord(FILE *savef, coord *c)
+#define RS_WINROWS 4                    /* Windows whose rows are kept */
+
+static struct rs_winrows
 {
-    coord in;
+    WINDOW *win;
+    int height, width;
+    chtype *cells;                      /* What each row held */
+    char *bytes;                        /* What it was written as */
+} rs_winrows[RS_WINROWS];
+static int rs_winnext = 0;
+static chtype *rs_winline = NULL;
+static int rs_winmax = 0;
 
-    rs_read_int(savef,&in.x);
-    rs_read_int(savef,&in.y);
+static struct rs_winrows *
+rs_find_rows(WINDOW *win, int height, int width)
+{
+    struct rs_winrows *wr;
+    int i;
 
-    if (!encerror()) 
+    for(i = 0; i < RS_WINROWS; i++)
+        if (rs_winrows[i].win == win && rs_winrows[i].height == height
+            && rs_winrows[i].width == width)
+            return(&rs_winrows[i]);
+
+    if (width + 1 > rs_winmax)
     {
-        c->x = in.x;
-        c->y = in.y;
+        free(rs_winline);
+        rs_winmax = 0;
+        if ((rs_winline = malloc((width + 1) * sizeof *rs_winline)) == NULL)
+            return(NULL);
+        rs_winmax = width + 1;
     }
-}
 
-void
-rs_write_str_t(FILE *savef, str_t str)
-{
-    rs_write_short(savef, str.st_str);
-    rs_write_short(savef, str.st_add);
-}
+    wr = &rs_winrows[rs_winnext];
+    rs_winnext = (rs_winnext + 1) % RS_WINROWS;
+    free(wr->cells);
+    free(wr->bytes);
+    wr->win = NULL;
+    wr->cells = calloc(height * width, sizeof *wr->cells);
+    wr->bytes = malloc(height * width * 4);
 
-void
-rs_read_str_t(FILE *savef, str_t *str)
-{
-    str_t in;
+    if (wr->cells == NULL || wr->bytes == NULL)
+        return(NULL);
 
-    rs_read_short(savef,&in.st_str);
-    rs_read_short(savef,&in.st_add);
+    /*
+        No cell holds 0, so every row is written the first time
+    */
+    wr->win = win;
+    wr->height = height;
+    wr->width = width;
 
-    if (!encerror()) 
-    {
-        str->st_str = in.st_str;
-	str->st_add = in.st_add;
-    }
+    return(wr);
 }
 
 void
 rs_write_window(FILE *savef, WINDOW *win)
 {
-    int row,col,height,width;
+    int row,col,height,width,oy,ox;
+    struct rs_winrows *wr;
+    chtype *cells;
+    size_t start;
 
     width = getmaxx(win);
     height = getmaxy(win);
+    getyx(win,oy,ox);
 
     rs_write_marker(savef,RSID_WINDOW);
     rs_write_int(savef,height);
     rs_write_int(savef,width);
     
-    for(row=0;row<height;row++)
-        for(col=0;col<width;col++)
-            rs_write_int(savef, mvwinch(win,row,col));
+    if ((wr = rs_find_rows(win, height, width)) == NULL)
+    {
+        for(row=0;row<height;row++)
+            for(col=0;col<width;col++)
+                rs_write_int(savef, mvwinch(win,row,col));
+    }
+    else
+        for(row=0;row<height;row++)
+        {
+            cells = &wr->cells[row * width];
+            mvwinchnstr(win, row, 0, rs_winline, width);
+
+            if (memcmp(rs_winline, cells, width * sizeof *cells) == 0)
+            {
+                rs_write(savef, &wr->bytes[row * width * 4], width * 4);
+                continue;
+            }
+
+            start = rs_len;
+
+            for(col=0;col<width;col++)
+                rs_write_int(savef, rs_winline[col]);
+
+            if (rs_len == start + width * 4)
+            {
+                memcpy(cells, rs_winline, width * sizeof *cells);
+                memcpy(&wr->bytes[row * width * 4], rs_buf + start, width * 4);
+            }
+        }
+
+    wmove(win,oy,ox);   /* snapshots are taken in the middle of play */
 }
 
 void
@@ -621,29 +781,162 @@ rs_read_window(FILE *savef, WINDOW *win)
 
 /******************************************************************************/
 
-void *
-get_list_item(struct linked_list *l, int i)
+/*
+    Pointer <-> list position tables.  Before saving, every place a
+    pointer can refer to is added once, and the hash gives its position
+    back in constant time.  While restoring, the same lists are added as
+    they are read, and the arrays turn positions back into pointers.
+    The tables are kept between saves so a snapshot every turn doesn't
+    allocate anything.
+*/
+
+struct rs_index_entry
 {
-    int cnt;
-        
-    for(cnt = 0; l != NULL; cnt++, l = l->l_next)
-        if (cnt == i)
-            return(l->l_data);
-        
-    return(NULL);
+    void *ptr;
+    int listid;
+    int index;
+};
+
+static void **rs_items[RS_NLISTS];
+static int rs_nitems[RS_NLISTS], rs_maxitems[RS_NLISTS];
+static struct rs_index_entry *rs_hash = NULL;
+static int rs_hashsize = 0, rs_hashused = 0;
+
+static unsigned int
+rs_hash_ptr(void *ptr, int listid)
+{
+    size_t p = (size_t) ptr;
+
+    return( (unsigned int) ((p >> 3) * 2654435761U + listid) );
 }
 
-int
-find_list_ptr(struct linked_list *l, void *ptr)
+static void
+rs_hash_insert(void *ptr, int listid, int index)
+{
+    unsigned int h = rs_hash_ptr(ptr, listid) & (rs_hashsize - 1);
+
+    while (rs_hash[h].ptr != NULL)
+        h = (h + 1) & (rs_hashsize - 1);
+
+    rs_hash[h].ptr = ptr;
+    rs_hash[h].listid = listid;
+    rs_hash[h].index = index;
+    rs_hashused++;
+}
+
+static int
+rs_hash_grow(void)
+{
+    struct rs_index_entry *h;
+    int listid, i, n = (rs_hashsize == 0) ? 256 : rs_hashsize * 2;
+
+    if ((h = calloc(n, sizeof(struct rs_index_entry))) == NULL)
+        return(-1);
+
+    free(rs_hash);
+    rs_hash = h;
+    rs_hashsize = n;
+    rs_hashused = 0;
+
+    for(listid = 0; listid < RS_NLISTS; listid++)
+        for(i = 0; i < rs_nitems[listid]; i++)
+            rs_hash_insert(rs_items[listid][i], listid, i);
+
+    return(0);
+}
+
+void
+rs_index_clear(void)
+{
+    int listid;
+
+    for(listid = 0; listid < RS_NLISTS; listid++)
+        rs_nitems[listid] = 0;
+
+    if (rs_hash != NULL)
+        memset(rs_hash, 0, rs_hashsize * sizeof(struct rs_index_entry));
+
+    rs_hashused = 0;
+}
+
+void
+rs_index_add(int listid, void *ptr)
+{
+    void **items;
+    int n = rs_nitems[listid];
+
+    if (n == rs_maxitems[listid])
     {
-    int cnt;
+        items = realloc(rs_items[listid], (n + 64) * sizeof(void *));
+
+        if (items == NULL)
+        {
+            encseterr(ENOMEM);
+            return;
+        }
+
+        rs_items[listid] = items;
+        rs_maxitems[listid] = n + 64;
+    }
+
+    rs_items[listid][n] = ptr;
+    rs_nitems[listid]++;
+
+    if (2 * (rs_hashused + 1) > rs_hashsize)
+    {
+        if (rs_hash_grow() != 0)
+            encseterr(ENOMEM);
+    }
+    else
+        rs_hash_insert(ptr, listid, n);
+}
+
+void
+rs_index_list(int listid, struct linked_list *l)
+{
+    for( ; l != NULL; l = l->l_next)
+        rs_index_add(listid, l->l_data);
+}
+
+void
+rs_index_things(struct linked_list *l)
+{
+    for( ; l != NULL; l = l->l_next)
+        rs_index_add(RS_LIST_MONSTERS, &((struct thing *) l->l_data)->t_pos);
+}
+
+void
+rs_index_objects(struct linked_list *l)
+{
+    for( ; l != NULL; l = l->l_next)
+        rs_index_add(RS_LIST_OBJECTS, &((struct object *) l->l_data)->o_pos);
+}
+
+int
+rs_index_find(int listid, void *ptr)
+{
+    unsigned int h;
+
+    if (ptr == NULL || rs_hashsize == 0)
+        return(-1);
+
+    h = rs_hash_ptr(ptr, listid) & (rs_hashsize - 1);
+
+    for( ; rs_hash[h].ptr != NULL; h = (h + 1) & (rs_hashsize - 1))
+        if (rs_hash[h].ptr == ptr && rs_hash[h].listid == listid)
+            return(rs_hash[h].index);
 
-    for(cnt = 0; l != NULL; cnt++, l = l->l_next)
-        if (l->l_data == ptr)
-            return(cnt);
-    
     return(-1);
-}       
+}
+
+void *
+rs_index_item(int listid, int i)
+{
+    if (i < 0 || i >= rs_nitems[listid])
+        return(NULL);
+
+    return(rs_items[listid][i]);
+}
 
 int
 list_size(struct linked_list *l)
@@ -660,31 +953,147 @@ list_size(struct linked_list *l)
 /******************************************************************************/
 
 void
-rs_write_stats(FILE *savef, struct stats *s)
-                    {
-    rs_write_marker(savef, RSID_STATS);
-    rs_write_str_t(savef, s->s_str);
-    rs_write_long(savef, s->s_exp);
-    rs_write_int(savef, s->s_lvl);
-    rs_write_int(savef, s->s_arm);
-    rs_write_int(savef, s->s_hpt);
-    rs_write_chars(savef, s->s_dmg, sizeof(s->s_dmg));
-}       
-        
+rs_write_fields(FILE *savef, const struct rs_field *f, void *base)
+{
+    char *p;
+    int n;
+
+    for( ; f->type != RS_END; f++)
+    {
+        p = (base != NULL) ? (char *) base + f->offset : (char *) f->addr;
+
+        switch(f->type)
+        {
+            case RS_MARKER:
+            case RS_LENGTH:
+                rs_write_int(savef, f->count);
+                continue;
+            case RS_SINCE:
+                continue;
+        }
+
+        for(n = 0; n < f->count; n++, p += f->size)
+            switch(f->type)
+            {
+                case RS_INT:    rs_write_int(savef, *(int *) p);        break;
+                case RS_SHORT:  rs_write_short(savef, *(short *) p);    break;
+                case RS_LONG:   rs_write_long(savef, *(long *) p);      break;
+                case RS_BOOL:   rs_write_boolean(savef, *(bool *) p);   break;
+                case RS_CHAR:   rs_write_char(savef, *p);               break;
+                case RS_CHARS:  rs_write_chars(savef, p, (int) f->size); break;
+                case RS_STRUCT: rs_write_fields(savef, f->sub, p);      break;
+                case RS_FUNC:   f->wfunc(savef, p);                     break;
+            }
+    }
+}
 
 void
-rs_read_stats(FILE *savef, struct stats *s)
+rs_read_fields(FILE *savef, const struct rs_field *f, void *base)
 {
-    rs_read_marker(savef, RSID_STATS);
-    rs_read_str_t(savef,&s->s_str);
-    rs_read_long(savef,&s->s_exp);
-    rs_read_int(savef,&s->s_lvl);
-    rs_read_int(savef,&s->s_arm);
-    rs_read_int(savef,&s->s_hpt);
-    rs_read_chars(savef,s->s_dmg,sizeof(s->s_dmg));
+    char *p;
+    int n, value;
+
+    for( ; f->type != RS_END && !encerror(); f++)
+    {
+        p = (base != NULL) ? (char *) base + f->offset : (char *) f->addr;
+
+        switch(f->type)
+        {
+            case RS_MARKER:
+                rs_read_marker(savef, f->count);
+                continue;
+            case RS_LENGTH:
+                rs_read_int(savef, &value);
+                if (!encerror() && value != f->count)
+                    encseterr(EILSEQ);
+                continue;
+            case RS_SINCE:
+                /* not in this file, so leave them as they are */
+                if (rs_version < f->count)
+                    while (f[1].type != RS_END && f[1].type != RS_SINCE)
+                        f++;
+                continue;
+        }
+
+        for(n = 0; n < f->count; n++, p += f->size)
+            switch(f->type)
+            {
+                case RS_INT:    rs_read_int(savef, (int *) p);          break;
+                case RS_SHORT:  rs_read_short(savef, (short *) p);      break;
+                case RS_LONG:   rs_read_long(savef, (long *) p);        break;
+                case RS_BOOL:   rs_read_boolean(savef, (bool *) p);     break;
+                case RS_CHAR:   rs_read_char(savef, p);                 break;
+                case RS_CHARS:  rs_read_chars(savef, p, (int) f->size); break;
+                case RS_STRUCT: rs_read_fields(savef, f->sub, p);       break;
+                case RS_FUNC:   f->rfunc(savef, p);                     break;
+            }
+    }
 }
 
-        
+static const struct rs_field rs_coord_fields[] =
+{
+    RS_MEMBER(RS_INT,    coord, x, 1, NULL),
+    RS_MEMBER(RS_INT,    coord, y, 1, NULL),
+    RS_TAG(RS_END, 0)
+};
+
+static const struct rs_field rs_str_t_fields[] =
+{
+    RS_MEMBER(RS_SHORT,  str_t, st_str, 1, NULL),
+    RS_MEMBER(RS_SHORT,  str_t, st_add, 1, NULL),
+    RS_TAG(RS_END, 0)
+};
+
+static const struct rs_field rs_stats_fields[] =
+{
+    RS_TAG(RS_MARKER, RSID_STATS),
+    RS_MEMBER(RS_STRUCT, struct stats, s_str, 1, rs_str_t_fields),
+    RS_MEMBER(RS_LONG,   struct stats, s_exp, 1, NULL),
+    RS_MEMBER(RS_INT,    struct stats, s_lvl, 1, NULL),
+    RS_MEMBER(RS_INT,    struct stats, s_arm, 1, NULL),
+    RS_MEMBER(RS_INT,    struct stats, s_hpt, 1, NULL),
+    RS_MEMBER(RS_CHARS,  struct stats, s_dmg, 1, NULL),
+    RS_TAG(RS_END, 0)
+};
+
+static const struct rs_field rs_room_fields[] =
+{
+    RS_MEMBER(RS_STRUCT, struct room, r_pos, 1, rs_coord_fields),
+    RS_MEMBER(RS_STRUCT, struct room, r_max, 1, rs_coord_fields),
+    RS_MEMBER(RS_STRUCT, struct room, r_gold, 1, rs_coord_fields),
+    RS_MEMBER(RS_INT,    struct room, r_goldval, 1, NULL),
+    RS_MEMBER(RS_INT,    struct room, r_flags, 1, NULL),
+    RS_MEMBER(RS_INT,    struct room, r_nexits, 1, NULL),
+    RS_MEMBER(RS_STRUCT, struct room, r_exit, 4, rs_coord_fields),
+    RS_TAG(RS_END, 0)
+};
+
+static const struct rs_field rs_trap_fields[] =
+{
+    RS_MEMBER(RS_STRUCT, struct trap, tr_pos, 1, rs_coord_fields),
+    RS_MEMBER(RS_CHAR,   struct trap, tr_type, 1, NULL),
+    RS_MEMBER(RS_INT,    struct trap, tr_flags, 1, NULL),
+    RS_TAG(RS_END, 0)
+};
+
+static const struct rs_field rs_object_fields[] =
+{
+    RS_TAG(RS_MARKER, RSID_OBJECT),
+    RS_MEMBER(RS_INT,    struct object, o_type, 1, NULL),
+    RS_MEMBER(RS_STRUCT, struct object, o_pos, 1, rs_coord_fields),
+    RS_MEMBER(RS_CHAR,   struct object, o_launch, 1, NULL),
+    RS_MEMBER(RS_CHARS,  struct object, o_damage, 1, NULL),
+    RS_MEMBER(RS_CHARS,  struct object, o_hurldmg, 1, NULL),
+    RS_MEMBER(RS_INT,    struct object, o_count, 1, NULL),
+    RS_MEMBER(RS_INT,    struct object, o_which, 1, NULL),
+    RS_MEMBER(RS_INT,    struct object, o_hplus, 1, NULL),
+    RS_MEMBER(RS_INT,    struct object, o_dplus, 1, NULL),
+    RS_MEMBER(RS_INT,    struct object, o_ac, 1, NULL),
+    RS_MEMBER(RS_INT,    struct object, o_flags, 1, NULL),
+    RS_MEMBER(RS_INT,    struct object, o_group, 1, NULL),
+    RS_TAG(RS_END, 0)
+};
+
 void
 rs_write_scrolls(FILE *savef)
 {
@@ -916,61 +1325,6 @@ rs_read_daemons(FILE *savef, struct delayed_action *dlist, int cnt)
     }
 }       
 
-void
-rs_write_room(FILE *savef, struct room *r)
-            {   
-    rs_write_coord(savef, r->r_pos);
-    rs_write_coord(savef, r->r_max);
-    rs_write_coord(savef, r->r_gold);
-    rs_write_int(savef, r->r_goldval);
-    rs_write_int(savef, r->r_flags);
-    rs_write_int(savef, r->r_nexits);
-    rs_write_coord(savef, r->r_exit[0]);
-    rs_write_coord(savef, r->r_exit[1]);
-    rs_write_coord(savef, r->r_exit[2]);
-    rs_write_coord(savef, r->r_exit[3]);
-            }
-
-void
-rs_read_room(FILE *savef, struct room *r)
-{
-    rs_read_coord(savef,&r->r_pos);
-    rs_read_coord(savef,&r->r_max);
-    rs_read_coord(savef,&r->r_gold);
-    rs_read_int(savef,&r->r_goldval);
-    rs_read_int(savef,&r->r_flags);
-    rs_read_int(savef,&r->r_nexits);
-    rs_read_coord(savef,&r->r_exit[0]);
-    rs_read_coord(savef,&r->r_exit[1]);
-    rs_read_coord(savef,&r->r_exit[2]);
-    rs_read_coord(savef,&r->r_exit[3]);
-}
-
-void
-rs_write_rooms(FILE *savef, struct room r[], int cnt)
-{
-    int n = 0;
-
-    rs_write_int(savef, cnt);
-
-    for(n = 0; n < cnt; n++)
-        rs_write_room(savef, &r[n]);
-}
-
-void
-rs_read_rooms(FILE *savef, struct room *r, int cnt)
-    {
-    int value = 0, n = 0;
-
-    rs_read_int(savef,&value);
-
-    if (!encerror() && (value > cnt))
-        encseterr(EILSEQ);
-    else
-    for(n = 0; n < value; n++)
-            rs_read_room(savef,&r[n]);
-    }
-
 void
 rs_write_room_reference(FILE *savef, struct room *rp)
 {
@@ -990,44 +1344,13 @@ rs_read_room_reference(FILE *savef, struct room **rp)
     
     rs_read_int(savef, &i);
 
-    if (!encerror())
-    *rp = &rooms[i];
-}
-
-void
-rs_write_object(FILE *savef, struct object *o)
-{
-    rs_write_marker(savef, RSID_OBJECT);
-    rs_write_int(savef, o->o_type);
-    rs_write_coord(savef, o->o_pos);
-    rs_write_char(savef, o->o_launch);
-    rs_write_chars(savef, o->o_damage, sizeof(o->o_damage));
-    rs_write_chars(savef, o->o_hurldmg, sizeof(o->o_hurldmg));
-    rs_write_int(savef, o->o_count);
-    rs_write_int(savef, o->o_which);
-    rs_write_int(savef, o->o_hplus);
-    rs_write_int(savef, o->o_dplus);
-    rs_write_int(savef, o->o_ac);
-    rs_write_int(savef, o->o_flags);
-    rs_write_int(savef, o->o_group);
-}
+    if (encerror())
+        return;
 
-void
-rs_read_object(FILE *savef, struct object *o)
-{
-    rs_read_marker(savef, RSID_OBJECT);
-    rs_read_int(savef, &o->o_type);
-    rs_read_coord(savef, &o->o_pos);
-    rs_read_char(savef, &o->o_launch);
-    rs_read_chars(savef, o->o_damage, sizeof(o->o_damage));
-    rs_read_chars(savef, o->o_hurldmg, sizeof(o->o_hurldmg));
-    rs_read_int(savef, &o->o_count);
-    rs_read_int(savef, &o->o_which);
-    rs_read_int(savef, &o->o_hplus);
-    rs_read_int(savef, &o->o_dplus);
-    rs_read_int(savef,&o->o_ac);
-    rs_read_int(savef,&o->o_flags);
-    rs_read_int(savef,&o->o_group);
+    if (i >= 0 && i < MAXROOMS)
+        *rp = &rooms[i];
+    else
+        *rp = NULL;
 }
 
 void
@@ -1037,7 +1360,7 @@ rs_write_object_list(FILE *savef, struct linked_list *l)
     rs_write_int(savef, list_size(l));
 
     for( ;l != NULL; l = l->l_next) 
-        rs_write_object(savef, (struct object *) l->l_data);
+        rs_write_fields(savef, rs_object_fields, l->l_data);
 }
 
 void
@@ -1063,7 +1386,7 @@ rs_read_object_list(FILE *savef, struct linked_list **list)
                 if (previous != NULL)
                     previous->l_next = l;
 
-        rs_read_object(savef,(struct object *) l->l_data);
+        rs_read_fields(savef, rs_object_fields, l->l_data);
 
                 if (previous == NULL)
                     head = l;
@@ -1078,99 +1401,29 @@ rs_read_object_list(FILE *savef, struct linked_list **list)
 }
 
 void
-rs_write_object_reference(FILE *savef, struct linked_list *list, struct object *item)
+rs_write_object_reference(FILE *savef, int listid, struct object *item)
 {
-    int i;
-
-    i = find_list_ptr(list, item);
-
-    rs_write_int(savef, i);
+    rs_write_int(savef, rs_index_find(listid, item));
 }
 
 void
-rs_read_object_reference(FILE *savef, struct linked_list *list, struct object **item)
+rs_read_object_reference(FILE *savef, int listid, struct object **item)
 {
     int i;
 
     rs_read_int(savef, &i);
 
     if (!encerror())
-    *item = get_list_item(list,i);
+        *item = rs_index_item(listid, i);
     else
 	*item = NULL;
 }
 
-int
-find_room_coord(const struct room *rmlist, const coord *c, int n)
-{
-    int i = 0;
-    
-    for(i = 0; i < n; i++)
-        if(&rmlist[i].r_gold == c)
-            return(i);
-
-    return(-1);
-}
-
-int
-find_thing_coord(struct linked_list *monlist, coord *c)
-{
-    struct linked_list *mitem;
-    struct thing *tp;
-    int i = 0;
-
-    for(mitem = monlist; mitem != NULL; mitem = mitem->l_next)
-    {
-        tp = (struct thing *)ldata(mitem);
-
-        if (c == &tp->t_pos)
-            return(i);
-
-        i++;
-    }
-
-    return(-1);
-}
-
-int
-find_object_coord(struct linked_list *objlist, coord *c)
-{
-    struct linked_list *oitem;
-    struct object *obj;
-    int i = 0;
-
-    for(oitem = objlist; oitem != NULL; oitem = oitem->l_next)
-    {
-        obj = (struct object *)ldata(oitem);
-
-        if (c == &obj->o_pos)
-            return(i);
-
-        i++;
-    }
-
-    return(-1);
-}
-
 void
-rs_write_thing(FILE *savef, struct thing *t)
+rs_write_dest(FILE *savef, void *p)
 {
+    struct thing *t = p;
     int i = -1;
-    
-    rs_write_marker(savef, RSID_THING);
-
-    if (t == NULL)
-    {
-        rs_write_int(savef, 0);
-        return;
-    }
-
-    rs_write_int(savef, 1);
-    rs_write_coord(savef, t->t_pos);
-    rs_write_boolean(savef, t->t_turn);
-    rs_write_char(savef, t->t_type);
-    rs_write_char(savef, t->t_disguise);
-    rs_write_char(savef, t->t_oldch);
 
     /* 
         t_dest can be:
@@ -1191,29 +1444,29 @@ rs_write_thing(FILE *savef, struct thing *t)
     }
     else if (t->t_dest != NULL)
     {
-        i = find_thing_coord(mlist, t->t_dest);
+        i = rs_index_find(RS_LIST_MONSTERS, t->t_dest);
             
         if (i >=0 )
         {
-            rs_write_int(savef,1);
+            rs_write_int(savef,RS_LIST_MONSTERS);
             rs_write_int(savef,i);
         }
         else
         {
-            i = find_object_coord(lvl_obj, t->t_dest);
+            i = rs_index_find(RS_LIST_OBJECTS, t->t_dest);
             
             if (i >= 0)
             {
-                rs_write_int(savef,2);
+                rs_write_int(savef,RS_LIST_OBJECTS);
                 rs_write_int(savef,i);
             }
             else
             {
-                i = find_room_coord(rooms, t->t_dest, MAXROOMS);
+                i = rs_index_find(RS_LIST_GOLD, t->t_dest);
         
                 if (i >= 0) 
                 {
-                    rs_write_int(savef,3);
+                    rs_write_int(savef,RS_LIST_GOLD);
                     rs_write_int(savef,i);
                 }
                 else 
@@ -1229,33 +1482,14 @@ rs_write_thing(FILE *savef, struct thing *t)
         rs_write_int(savef,0);
         rs_write_int(savef,0);
     }
-    
-    rs_write_short(savef, t->t_flags);
-    rs_write_stats(savef, &t->t_stats);
-    rs_write_object_list(savef, t->t_pack);
 }
 
 void
-rs_read_thing(FILE *savef, struct thing *t)
+rs_read_dest(FILE *savef, void *p)
 {
+    struct thing *t = p;
     int listid = 0, index = -1;
-    struct linked_list *item;
-        
-    rs_read_marker(savef, RSID_THING);
-    rs_read_int(savef, &index);
 
-    if (encerror())
-	return;
-
-    if (index == 0)
-        return;
-
-    rs_read_coord(savef,&t->t_pos);
-    rs_read_boolean(savef,&t->t_turn);
-    rs_read_char(savef,&t->t_type);
-    rs_read_char(savef,&t->t_disguise);
-    rs_read_char(savef,&t->t_oldch);
-            
     /* 
         t_dest can be (listid,index):
         0,0: NULL
@@ -1282,51 +1516,88 @@ rs_read_thing(FILE *savef, struct thing *t)
                 else
                     t->t_dest = NULL;
             }
-    else if (listid == 1) /* monster/thing */
+    else if (listid == RS_LIST_MONSTERS) /* monster/thing */
             {
                 t->t_dest     = NULL;
                 t->t_reserved = index;
             }
-    else if (listid == 2) /* object */
+    else if (listid == RS_LIST_OBJECTS) /* object */
             {
-                struct object *obj;
-
-                item = get_list_item(lvl_obj,index);
-
-                if (item != NULL)
-                {
-	    obj = (struct object *)ldata(item);
-                    t->t_dest = &obj->o_pos;
-                }
+                t->t_dest = rs_index_item(RS_LIST_OBJECTS, index);
             }
-    else if (listid == 3) /* gold */
+    else if (listid == RS_LIST_GOLD && index >= 0 && index < MAXROOMS)
             {
                 t->t_dest = &rooms[index].r_gold;
             }
             else
                 t->t_dest = NULL;
-            
-    rs_read_short(savef,&t->t_flags);
-    rs_read_stats(savef,&t->t_stats);
-    rs_read_object_list(savef,&t->t_pack);
 }
 
 void
-rs_fix_thing(struct thing *t)
+rs_write_pack(FILE *savef, void *p)
 {
-    struct linked_list *item;
-    struct thing *tp;
+    rs_write_object_list(savef, *(struct linked_list **) p);
+}
 
-    if (t->t_reserved < 0)
-        return;
+void
+rs_read_pack(FILE *savef, void *p)
+{
+    rs_read_object_list(savef, (struct linked_list **) p);
+}
+
+static const struct rs_field rs_thing_fields[] =
+{
+    RS_MEMBER(RS_STRUCT, struct thing, t_pos, 1, rs_coord_fields),
+    RS_MEMBER(RS_BOOL,   struct thing, t_turn, 1, NULL),
+    RS_MEMBER(RS_CHAR,   struct thing, t_type, 1, NULL),
+    RS_MEMBER(RS_CHAR,   struct thing, t_disguise, 1, NULL),
+    RS_MEMBER(RS_CHAR,   struct thing, t_oldch, 1, NULL),
+    RS_CALL(NULL, rs_write_dest, rs_read_dest),
+    RS_MEMBER(RS_SHORT,  struct thing, t_flags, 1, NULL),
+    RS_MEMBER(RS_STRUCT, struct thing, t_stats, 1, rs_stats_fields),
+    RS_MEMBERCALL(struct thing, t_pack, rs_write_pack, rs_read_pack),
+    RS_TAG(RS_END, 0)
+};
 
-    item = get_list_item(mlist,t->t_reserved);
+void
+rs_write_thing(FILE *savef, struct thing *t)
+{
+    rs_write_marker(savef, RSID_THING);
 
-    if (item != NULL)
+    if (t == NULL)
     {
-        tp = (struct thing *)ldata(item);
-        t->t_dest = &tp->t_pos;
+        rs_write_int(savef, 0);
+        return;
     }
+
+    rs_write_int(savef, 1);
+    rs_write_fields(savef, rs_thing_fields, t);
+}
+
+void
+rs_read_thing(FILE *savef, struct thing *t)
+{
+    int index = -1;
+        
+    rs_read_marker(savef, RSID_THING);
+    rs_read_int(savef, &index);
+
+    if (encerror())
+	return;
+
+    if (index == 0)
+        return;
+
+    rs_read_fields(savef, rs_thing_fields, t);
+}
+
+void
+rs_fix_thing(struct thing *t)
+{
+    if (t->t_reserved < 0)
+        return;
+
+    t->t_dest = rs_index_item(RS_LIST_MONSTERS, t->t_reserved);
 }
 
 void
@@ -1409,50 +1680,6 @@ rs_fix_monsters(struct monster mons[26])
     sprintf(mons['F'-'A'].m_stats.s_dmg,"%dd1",fung_hit);
 }
 
-void
-rs_write_trap(FILE *savef, struct trap *trap)
-{
-    rs_write_coord(savef, trap->tr_pos);
-    rs_write_char(savef, trap->tr_type);
-    rs_write_int(savef, trap->tr_flags);
-}
-
-void
-rs_read_trap(FILE *savef, struct trap *trap)
-{
-    rs_read_coord(savef,&trap->tr_pos);
-    rs_read_char(savef,&trap->tr_type);
-    rs_read_int(savef,&trap->tr_flags);
-}
-
-void
-rs_write_traps(FILE *savef, struct trap t[], int cnt)
-{
-    int n = 0;
-
-    rs_write_marker(savef, RSID_MONSTERS);
-    rs_write_int(savef, cnt);
-    
-    for(n = 0; n < cnt; n++)
-        rs_write_trap(savef, &t[n]);
-}
-
-void
-rs_read_traps(FILE *savef, struct trap *t, int cnt)
-{
-    int value = 0, n = 0;
-
-    rs_read_marker(savef, RSID_MONSTERS);
-
-    rs_read_int(savef,&value);
-
-    if (!encerror() && (value > cnt))
-        encseterr(EILSEQ);
-
-    for(n = 0; n < value; n++)
-        rs_read_trap(savef,&t[n]);
-}
-
 void
 rs_write_stat(FILE *savef, struct stat *sbuf)
 {
@@ -1504,168 +1731,372 @@ rs_read_stat(FILE *savef, struct stat *sbuf)
 	sbuf->st_dev = (long long) dev[1] << 32 | dev[0];
 }
 
-extern struct stat sbuf;
+/*
+    auto_save() can't use rs_buf from a signal handler, so it has the
+    stat record made in a buffer of its own.
+*/
 
 int
-rs_save_file(FILE *savef)
+rs_encode_stat(char *buf, int max, struct stat *sbuf)
 {
-    encclearerr();
+    char *obuf = rs_buf;
+    size_t olen = rs_len, omax = rs_max;
+    int len;
+
+    rs_buf = buf;
+    rs_len = 0;
+    rs_max = max;
+    rs_fixed = TRUE;
+
+    rs_write_stat(NULL, sbuf);
+    len = (int) rs_len;
+
+    rs_buf = obuf;
+    rs_len = olen;
+    rs_max = omax;
+    rs_fixed = FALSE;
+
+    return(len);
+}
+
+/*
+    RS_FUNC entries for the game table
+*/
+
+static void
+rs_write_hero(FILE *savef, void *p)
+{
+    rs_write_thing(savef, p);
+}
+
+static void
+rs_read_hero(FILE *savef, void *p)
+{
+    rs_read_thing(savef, p);
+    rs_index_list(RS_LIST_PACK, player.t_pack);
+}
+
+static void
+rs_read_lvl_obj(FILE *savef, void *p)
+{
+    rs_read_object_list(savef, &lvl_obj);
+    rs_index_objects(lvl_obj);
+}
+
+static void
+rs_write_mlist(FILE *savef, void *p)
+{
+    rs_write_thing_list(savef, mlist);
+}
+
+static void
+rs_read_mlist(FILE *savef, void *p)
+{
+    rs_read_thing_list(savef, &mlist);
+    rs_index_things(mlist);
+}
 
-    rs_write_thing(savef, &player);                     
-    rs_write_object_list(savef, lvl_obj);               
-    rs_write_thing_list(savef, mlist);                
-    rs_write_traps(savef, traps, MAXTRAPS);             
-    rs_write_rooms(savef, rooms, MAXROOMS);             
-    rs_write_room_reference(savef, oldrp);              
-    rs_write_stats(savef,&max_stats);                   
-    rs_write_object_reference(savef, player.t_pack, cur_weapon); 
-    rs_write_object_reference(savef, player.t_pack, cur_armor);
-    rs_write_object_reference(savef, player.t_pack, cur_ring[0]);
-    rs_write_object_reference(savef, player.t_pack, cur_ring[1]);
-    rs_write_int(savef, level);                         
-    rs_write_int(savef, purse);                         
-    rs_write_int(savef, mpos);                          
-    rs_write_int(savef, ntraps);                        
-    rs_write_int(savef, no_move);                       
-    rs_write_int(savef, no_command);                    
-    rs_write_int(savef, inpack);                        
-    rs_write_int(savef, max_hp);                        
-    rs_write_int(savef, total);                         
-    rs_write_int(savef, lastscore);                     
-    rs_write_int(savef, no_food);                       
-    rs_write_int(savef, seed);                          
-    rs_write_int(savef, count);                         
-    rs_write_int(savef, dnum);                          
-    rs_write_int(savef, fung_hit);                      
-    rs_write_int(savef, quiet);                         
-    rs_write_int(savef, max_level);                     
-    rs_write_int(savef, food_left);                     
-    rs_write_int(savef, group);                         
-    rs_write_int(savef, hungry_state);                  
-    rs_write_char(savef, take);
-    rs_write_char(savef, runch);
+static void
+rs_write_oldrp(FILE *savef, void *p)
+{
+    rs_write_room_reference(savef, oldrp);
+}
+
+static void
+rs_read_oldrp(FILE *savef, void *p)
+{
+    rs_read_room_reference(savef, &oldrp);
+}
+
+static void
+rs_write_worn(FILE *savef, void *p)
+{
+    rs_write_object_reference(savef, RS_LIST_PACK, *(struct object **) p);
+}
+
+static void
+rs_read_worn(FILE *savef, void *p)
+{
+    rs_read_object_reference(savef, RS_LIST_PACK, (struct object **) p);
+}
+
+static void
+rs_write_magic(FILE *savef, void *p)
+{
     rs_write_scrolls(savef);
     rs_write_potions(savef);
     rs_write_rings(savef);
     rs_write_sticks(savef);
-    rs_write_chars(savef,whoami,80);
-    rs_write_chars(savef,fruit,80);
+}
+
+static void
+rs_read_magic(FILE *savef, void *p)
+{
+    rs_read_scrolls(savef);
+    rs_read_potions(savef);
+    rs_read_rings(savef);
+    rs_read_sticks(savef);
+}
+
+static void
+rs_write_screen(FILE *savef, void *p)
+{
     rs_write_window(savef, cw);
     rs_write_window(savef, mw);
     rs_write_window(savef, stdscr);
-    rs_write_boolean(savef, running);                   
-    rs_write_boolean(savef, playing);                   
-    rs_write_boolean(savef, wizard);                    
-    rs_write_boolean(savef, after);
-    rs_write_boolean(savef, notify);                    
-    rs_write_boolean(savef, fight_flush);               
-    rs_write_boolean(savef, terse);                     
-    rs_write_boolean(savef, door_stop);                 
-    rs_write_boolean(savef, jump);                      
-    rs_write_boolean(savef, slow_invent);               
-    rs_write_boolean(savef, firstmove);                 
-    rs_write_boolean(savef, waswizard);                 
-    rs_write_boolean(savef, askme);                     
-    rs_write_boolean(savef, amulet);                    
-    rs_write_boolean(savef, in_shell);                  
-    rs_write_coord(savef, oldpos);                      
-    rs_write_coord(savef, delta);                       
-    rs_write_coord(savef, ch_ret);                      /* chase.c      */
-    rs_write_daemons(savef, &d_list[0], 20);            /* daemon.c     */
-    rs_write_int(savef,between);                        /* daemons.c    */
+}
+
+static void
+rs_read_screen(FILE *savef, void *p)
+{
+    rs_read_window(savef, cw);
+    rs_read_window(savef, mw);
+    rs_read_window(savef, stdscr);
+}
+
+static void
+rs_write_d_list(FILE *savef, void *p)
+{
+    rs_write_daemons(savef, &d_list[0], 20);
+}
+
+static void
+rs_read_d_list(FILE *savef, void *p)
+{
+    rs_read_daemons(savef, d_list, 20);
+}
+
+static int rs_unused = 0;
+
+/*
+    Everything else, in the order it is in the file
+*/
+
+static const struct rs_field rs_game_fields[] =
+{
+    RS_CALL(&player,        rs_write_hero,  rs_read_hero),
+    RS_CALL(&lvl_obj,       rs_write_pack,  rs_read_lvl_obj),
+    RS_CALL(NULL,           rs_write_mlist, rs_read_mlist),
+    RS_TAG(RS_MARKER, RSID_MONSTERS),
+    RS_TAG(RS_LENGTH, MAXTRAPS),
+    RS_GLOBAL(RS_STRUCT,    traps, MAXTRAPS, rs_trap_fields),
+    RS_TAG(RS_LENGTH, MAXROOMS),
+    RS_GLOBAL(RS_STRUCT,    rooms, MAXROOMS, rs_room_fields),
+    RS_CALL(NULL,           rs_write_oldrp, rs_read_oldrp),
+    RS_GLOBAL(RS_STRUCT,    max_stats, 1, rs_stats_fields),
+    RS_CALL(&cur_weapon,    rs_write_worn,  rs_read_worn),
+    RS_CALL(&cur_armor,     rs_write_worn,  rs_read_worn),
+    RS_CALL(&cur_ring[0],   rs_write_worn,  rs_read_worn),
+    RS_CALL(&cur_ring[1],   rs_write_worn,  rs_read_worn),
+    RS_GLOBAL(RS_INT,       level, 1, NULL),
+    RS_GLOBAL(RS_INT,       purse, 1, NULL),
+    RS_GLOBAL(RS_INT,       mpos, 1, NULL),
+    RS_GLOBAL(RS_INT,       ntraps, 1, NULL),
+    RS_GLOBAL(RS_INT,       no_move, 1, NULL),
+    RS_GLOBAL(RS_INT,       no_command, 1, NULL),
+    RS_GLOBAL(RS_INT,       inpack, 1, NULL),
+    RS_GLOBAL(RS_INT,       max_hp, 1, NULL),
+    RS_GLOBAL(RS_INT,       total, 1, NULL),
+    RS_GLOBAL(RS_INT,       lastscore, 1, NULL),
+    RS_GLOBAL(RS_INT,       no_food, 1, NULL),
+    RS_GLOBAL(RS_INT,       seed, 1, NULL),
+    RS_GLOBAL(RS_INT,       count, 1, NULL),
+    RS_GLOBAL(RS_INT,       dnum, 1, NULL),
+    RS_GLOBAL(RS_INT,       fung_hit, 1, NULL),
+    RS_GLOBAL(RS_INT,       quiet, 1, NULL),
+    RS_GLOBAL(RS_INT,       max_level, 1, NULL),
+    RS_GLOBAL(RS_INT,       food_left, 1, NULL),
+    RS_GLOBAL(RS_INT,       group, 1, NULL),
+    RS_GLOBAL(RS_INT,       hungry_state, 1, NULL),
+    RS_GLOBAL(RS_CHAR,      take, 1, NULL),
+    RS_GLOBAL(RS_CHAR,      runch, 1, NULL),
+    RS_CALL(NULL,           rs_write_magic, rs_read_magic),
+    RS_GLOBAL(RS_CHARS,     whoami, 1, NULL),
+    RS_GLOBAL(RS_CHARS,     fruit, 1, NULL),
+    RS_CALL(NULL,           rs_write_screen, rs_read_screen),
+    RS_GLOBAL(RS_BOOL,      running, 1, NULL),
+    RS_GLOBAL(RS_BOOL,      playing, 1, NULL),
+    RS_GLOBAL(RS_BOOL,      wizard, 1, NULL),
+    RS_GLOBAL(RS_BOOL,      after, 1, NULL),
+    RS_GLOBAL(RS_BOOL,      notify, 1, NULL),
+    RS_GLOBAL(RS_BOOL,      fight_flush, 1, NULL),
+    RS_GLOBAL(RS_BOOL,      terse, 1, NULL),
+    RS_GLOBAL(RS_BOOL,      door_stop, 1, NULL),
+    RS_GLOBAL(RS_BOOL,      jump, 1, NULL),
+    RS_GLOBAL(RS_BOOL,      slow_invent, 1, NULL),
+    RS_GLOBAL(RS_BOOL,      firstmove, 1, NULL),
+    RS_GLOBAL(RS_BOOL,      waswizard, 1, NULL),
+    RS_GLOBAL(RS_BOOL,      askme, 1, NULL),
+    RS_GLOBAL(RS_BOOL,      amulet, 1, NULL),
+    RS_GLOBAL(RS_BOOL,      in_shell, 1, NULL),
+    RS_GLOBAL(RS_STRUCT,    oldpos, 1, rs_coord_fields),
+    RS_GLOBAL(RS_STRUCT,    delta, 1, rs_coord_fields),
+    RS_GLOBAL(RS_STRUCT,    ch_ret, 1, rs_coord_fields),   /* chase.c      */
+    RS_CALL(NULL,           rs_write_d_list, rs_read_d_list), /* daemon.c */
+    RS_GLOBAL(RS_INT,       between, 1, NULL),      /* daemons.c    */
 #ifdef CHECKTIME
-    rs_write_int(savef,num_checks);                     /* main.c       */
+    RS_GLOBAL(RS_INT,       num_checks, 1, NULL),   /* main.c       */
 #else
-    rs_write_int(savef,0);
+    RS_GLOBAL(RS_INT,       rs_unused, 1, NULL),
 #endif
-    rs_write_chars(savef,lvl_mons,sizeof(lvl_mons));    /* monsters.c   */
-    rs_write_chars(savef,wand_mons,sizeof(wand_mons));	/* monsters.c   */
+    RS_GLOBAL(RS_CHARS,     lvl_mons, 1, NULL),     /* monsters.c   */
+    RS_GLOBAL(RS_CHARS,     wand_mons, 1, NULL),    /* monsters.c   */
+    RS_TAG(RS_SINCE, 5),
+    RS_GLOBAL(RS_INT,       turns, 1, NULL),
+    RS_TAG(RS_END, 0)
+};
 
-    return( encclearerr() );
+extern struct stat sbuf;
+
+static void
+rs_index_game(void)
+{
+    int i;
+
+    rs_index_clear();
+    rs_index_things(mlist);
+    rs_index_objects(lvl_obj);
+    for(i = 0; i < MAXROOMS; i++)
+        rs_index_add(RS_LIST_GOLD, &rooms[i].r_gold);
+    rs_index_list(RS_LIST_PACK, player.t_pack);
 }
 
 int
-rs_restore_file(FILE *savef)
+rs_save_file(FILE *savef)
 {
-    int junk = 0;
     encclearerr();
-    rs_read_thing(savef, &player);                        
-    rs_read_object_list(savef, &lvl_obj);                 
-    rs_read_thing_list(savef, &mlist);                  
+
+    rs_index_game();
+
+    rs_len = 0;
+    rs_write_fields(savef, rs_game_fields, NULL);
+
+    if (!encerror())
+        encwrite(rs_buf, rs_len, savef);
+
+    rs_len = 0;
+    rs_write_stat(savef, &sbuf);                        /* save.c       */
+
+    if (rs_len != RS_STAT_SIZE)
+        encseterr(EINVAL);
+
+    if (!encerror())
+        encwrite(rs_buf, rs_len, savef);
+
+    return( encclearerr() );
+}
+
+/*
+    A digest of the game state, for checking a replay came out the same.
+    It is taken over the same fields as a save, without the stat record.
+*/
+
+unsigned long
+rs_digest(void)
+{
+    unsigned long h = 2166136261UL;
+    size_t i, len;
+    char *img;
+
+    img = rs_frame(&len);
+
+    for(i = 0; i < len; i++)
+        h = ((h ^ (unsigned char) img[i]) * 16777619UL) & 0xffffffffUL;
+
+    return(h);
+}
+
+/*
+    Keyframes for replays are the same fields again, not encrypted.
+    rs_frame() hands back rs_buf, good until the next save or frame.
+*/
+
+char *
+rs_frame(size_t *len)
+{
+    encclearerr();
+
+    rs_index_game();
+
+    rs_len = 0;
+    rs_write_fields(NULL, rs_game_fields, NULL);
+
+    *len = encclearerr() ? 0 : rs_len;
+
+    return(rs_buf);
+}
+
+static void
+rs_fix_game(void)
+{
     rs_fix_thing(&player);
     rs_fix_thing_list(mlist);
-    rs_read_traps(savef, traps, MAXTRAPS);
-    rs_read_rooms(savef, rooms, MAXROOMS);
-    rs_read_room_reference(savef, &oldrp);
-    rs_read_stats(savef,&max_stats);                      
-    rs_read_object_reference(savef, player.t_pack, &cur_weapon);
-    rs_read_object_reference(savef, player.t_pack, &cur_armor);
-    rs_read_object_reference(savef, player.t_pack, &cur_ring[0]);
-    rs_read_object_reference(savef, player.t_pack, &cur_ring[1]);
     rs_fix_magic_items(things,NUMTHINGS);         
     rs_fix_magic_items(s_magic,MAXSCROLLS);       
     rs_fix_magic_items(p_magic,MAXPOTIONS);       
     rs_fix_magic_items(r_magic,MAXRINGS);         
     rs_fix_magic_items(ws_magic,MAXSTICKS);       
-    rs_read_int(savef, &level);                           
-    rs_read_int(savef, &purse);                           
-    rs_read_int(savef, &mpos);                            
-    rs_read_int(savef, &ntraps);                          
-    rs_read_int(savef, &no_move);                         
-    rs_read_int(savef, &no_command);                      
-    rs_read_int(savef, &inpack);                          
-    rs_read_int(savef, &max_hp);                          
-    rs_read_int(savef, &total);                           
-    rs_read_int(savef, &lastscore);                       
-    rs_read_int(savef, &no_food);                         
-    rs_read_int(savef, &seed);                            
-    rs_read_int(savef, &count);                           
-    rs_read_int(savef, &dnum);                            
-    rs_read_int(savef, &fung_hit);                        
-    rs_read_int(savef, &quiet);                           
-    rs_read_int(savef, &max_level);                       
-    rs_read_int(savef, &food_left);                       
-    rs_read_int(savef, &group);                           
-    rs_read_int(savef, &hungry_state);                    
-    rs_read_char(savef, &take);
-    rs_read_char(savef, &runch);
-    rs_read_scrolls(savef);
-    rs_read_potions(savef);
-    rs_read_rings(savef);
-    rs_read_sticks(savef);
-    rs_read_chars(savef,whoami,80);
-    rs_read_chars(savef,fruit,80);
-    rs_read_window(savef, cw);
-    rs_read_window(savef, mw);
-    rs_read_window(savef, stdscr);
-    rs_read_boolean(savef, &running);                     
-    rs_read_boolean(savef, &playing);                     
-    rs_read_boolean(savef, &wizard);                      
-    rs_read_boolean(savef, &after);
-    rs_read_boolean(savef, &notify);                      
-    rs_read_boolean(savef, &fight_flush);                 
-    rs_read_boolean(savef, &terse);                       
-    rs_read_boolean(savef, &door_stop);                   
-    rs_read_boolean(savef, &jump);                        
-    rs_read_boolean(savef, &slow_invent);                 
-    rs_read_boolean(savef, &firstmove);                   
-    rs_read_boolean(savef, &waswizard);                   
-    rs_read_boolean(savef, &askme);                       
-    rs_read_boolean(savef, &amulet);                      
-    rs_read_boolean(savef, &in_shell);                    
-    rs_read_coord(savef,&oldpos);                         
-    rs_read_coord(savef,&delta);                          
-    rs_read_coord(savef, &ch_ret);                        /* chase.c      */
-    rs_read_daemons(savef, d_list, 20);                   /* daemon.c     */
-    rs_read_int(savef,&between);                          /* daemons.c    */
-#ifdef CHECKTIME
-    rs_read_int(savef,&num_checks);                       /* main.c       */
-#else
-    rs_read_int(savef,&junk);
-#endif
-    rs_read_chars(savef, lvl_mons, sizeof(lvl_mons));     /* monsters.c   */
-    rs_read_chars(savef, wand_mons, sizeof(wand_mons));	/* monsters.c   */
     rs_fix_monsters(monsters);    
+}
+
+int
+rs_read_frame(char *img, size_t len)
+{
+    encclearerr();
+    rs_index_clear();
+    rs_version = RS_FORMAT;
+
+    rs_len = rs_pos = 0;
+
+    if (rs_reserve(len) != 0)
+        return( encclearerr() );
+
+    memcpy(rs_buf, img, len);
+    rs_len = len;
+
+    rs_read_fields(NULL, rs_game_fields, NULL);
+
+    rs_fix_game();
+
+    return( encclearerr() );
+}
+
+int
+rs_restore_image(char *img, size_t len, int version)
+{
+    FILE *savef = NULL;
+
+    encclearerr();
+    rs_index_clear();
+    rs_version = version;
+
+    /*
+        Since format 4 the stat record is encrypted apart from the rest
+    */
+
+    rs_len = rs_pos = 0;
+
+    if (rs_reserve(len) != 0)
+        return( encclearerr() );
+
+    memcpy(rs_buf, img, len);
+    rs_len = len;
+
+    if (version >= 4)
+    {
+        if (rs_len < RS_STAT_SIZE)
+            return(EILSEQ);
+
+        enccrypt(rs_buf, rs_len - RS_STAT_SIZE);
+        enccrypt(rs_buf + rs_len - RS_STAT_SIZE, RS_STAT_SIZE);
+    }
+
+    rs_read_fields(savef, rs_game_fields, NULL);
+    rs_read_stat(savef, &sbuf);                           /* save.c       */
+
+    rs_fix_game();
+
+    rs_version = RS_FORMAT;
 
     return( encclearerr() );
 }
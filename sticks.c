@@ -319,11 +319,16 @@ bool gotdir;
 				msg("The %s whizzes by you", name);
 			}
 			mvwaddch(cw, pos.y, pos.x, dirch);
-			draw(cw);
+			fly_frame();
 		}
 		pos.y += delta.y;
 		pos.x += delta.x;
 	    }
+	    if (flyrate <= 0)
+	    {
+		draw(cw);		/* the whole bolt at once */
+		scr_flush();
+	    }
 	    for (x = 0; x < y; x++)
 		mvwaddch(cw, spotpos[x].y, spotpos[x].x, show(spotpos[x].y, spotpos[x].x));
 	    ws_know[obj->o_which] = TRUE;
@@ -332,6 +337,7 @@ bool gotdir;
 	    msg("What a bizarre schtick!");
     }
     obj->o_charges--;
+    newnames();
 }
 
 /*
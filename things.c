@@ -11,14 +11,27 @@
 #include "rogue.h"
 
 /*
- * inv_name:
- *	return the name of something as it would appear in an
- *	inventory.
+ * Names are built once and then copied out of n_cache until something
+ * they depend on changes: the object's own fields, whether it is worn or
+ * wielded, or what he knows or has called things (namegen).
  */
-char *
-inv_name(obj, drop)
+
+#define N_CACHE	64			/* Power of two */
+
+static struct nkey {
+    struct object *n_obj;
+    int n_gen, n_worn;
+    int n_type, n_which, n_count, n_hplus, n_dplus, n_ac, n_flags;
+    char n_name[sizeof prbuf];
+} n_cache[N_CACHE];
+
+/*
+ * obj_name:
+ *	build the name of something in prbuf
+ */
+static void
+obj_name(obj)
 register struct object *obj;
-register bool drop;
 {
     register char *pb;
 
@@ -122,6 +135,45 @@ register bool drop;
 	strcat(prbuf, " (on left hand)");
     else if (obj == cur_ring[RIGHT])
 	strcat(prbuf, " (on right hand)");
+}
+
+/*
+ * inv_name:
+ *	return the name of something as it would appear in an
+ *	inventory.
+ */
+char *
+inv_name(obj, drop)
+register struct object *obj;
+register bool drop;
+{
+    register struct nkey *np;
+    register int worn;
+
+    worn = (obj == cur_armor) | (obj == cur_weapon) << 1
+	| (obj == cur_ring[LEFT]) << 2 | (obj == cur_ring[RIGHT]) << 3;
+    np = &n_cache[((unsigned long) obj / sizeof *obj) & (N_CACHE-1)];
+    if (np->n_obj != obj || np->n_gen != namegen || np->n_worn != worn
+      || np->n_type != obj->o_type || np->n_which != obj->o_which
+      || np->n_count != obj->o_count || np->n_hplus != obj->o_hplus
+      || np->n_dplus != obj->o_dplus || np->n_ac != obj->o_ac
+      || np->n_flags != obj->o_flags)
+    {
+	obj_name(obj);
+	strcpy(np->n_name, prbuf);
+	np->n_obj = obj;
+	np->n_gen = namegen;
+	np->n_worn = worn;
+	np->n_type = obj->o_type;
+	np->n_which = obj->o_which;
+	np->n_count = obj->o_count;
+	np->n_hplus = obj->o_hplus;
+	np->n_dplus = obj->o_dplus;
+	np->n_ac = obj->o_ac;
+	np->n_flags = obj->o_flags;
+    }
+    else
+	strcpy(prbuf, np->n_name);
     if (drop && isupper(prbuf[0]))
 	prbuf[0] = tolower(prbuf[0]);
     else if (!drop && islower(*prbuf))
@@ -195,7 +247,7 @@ drop()
 		inpack++;
     }
     else
-	detach(pack, obj);
+	del_pack(obj);
     inpack--;
     /*
      * Link it into the level object list
@@ -73,7 +73,7 @@ int ydelta, xdelta;
      */
     if (obj->o_count < 2)
     {
-	detach(pack, item);
+	del_pack(item);
 	inpack--;
     }
     else
@@ -137,7 +137,7 @@ register int ydelta, xdelta;
 		mvwinch(cw, obj->o_pos.y, obj->o_pos.x) != ' ')
 	    {
 		mvwaddch(cw, obj->o_pos.y, obj->o_pos.x, obj->o_type);
-		draw(cw);
+		fly_frame();
 	    }
 	    continue;
 	}
@@ -62,6 +62,7 @@ whatis()
 		r_guess[obj->o_which] = NULL;
 	    }
     }
+    newnames();
     msg(inv_name(obj, FALSE));
 }
 